@@ -0,0 +1,366 @@
+#ifndef FG_EVAL_H
+#define FG_EVAL_H
+
+#include <cmath>
+#include <cstddef>
+#include <cppad/cppad.hpp>
+#include "MPC_config.h"
+#include "MPC_layout.h"
+#include "MPC_nlp.h"
+
+using CppAD::AD;
+
+/* The model is as follows:
+x_t+1 = x_t + v_t * cos(phi_t) * dt
+y_t+1 = y_t + v_t * sin(phi_t) * dt
+phi_t+1 = phi_t + v_t/L_f * delta_t * dt
+v_t+1 = v_t + a_t * d_t
+cte_t+1 = f(x_t) - y_t + v_t*sin(ephi_t) * dt
+ephi_t+1 = phi_t - phidest_t + v_t/L_f*delta_t *dt
+
+x0 is the initial state [x ,y , \psi, v, cte, e\psi],
+coeffs are the coefficients of the fitting polynomial.
+The bulk of this method is setting up the vehicle model constraints (constraints) and variables (vars) for Ipopt.
+The horizon N is the template parameter of MPC, see the instantiations at the
+end of MPC.cpp. The timestep duration, Lf and the weights are in MPC_config.
+*/
+
+template <size_t N>
+class FG_eval : public MPC_layout<N> {
+public:
+	MPC_LAYOUT_USING(N);
+
+	// The polynomial coefficients are appended to the vars on the tape.
+	static constexpr size_t n_coeffs = 4;
+
+	const MPC_config &config;
+	FG_eval(const MPC_config &config) : config(config) {}
+
+	typedef CPPAD_TESTVECTOR(AD<double>) ADvector;
+	void operator()(ADvector& fg, const ADvector& vars) {
+		/*
+		* `fg` is a vector of the cost constraints, `vars` is a vector of variable
+		*   values (state & actuators) followed by the fitted polynomial coefficients
+		*/
+		fg[0] = 0;
+
+		// Fitted polynomial coefficients
+		AD<double> coeffs[4];
+		for (unsigned int i = 0; i < n_coeffs; i++) {
+			coeffs[i] = vars[n_vars + i];
+		}
+
+		const double dt = config.dt;
+		const double Lf = config.Lf;
+		const double ref_v = config.ref_v;
+
+		/* Cost function */
+
+		// the weights can be tuned in MPC_config
+		const double pen_cte = config.pen_cte;
+		const double pen_angle = config.pen_angle;
+		const double pen_speed = config.pen_speed;
+		const double pen_steering = config.pen_steering;
+		const double pen_throttle = config.pen_throttle;
+		const double pen_st_angle = config.pen_st_angle;
+		const double pen_break = config.pen_break;
+
+		for (unsigned int t = 0; t < N; t++) {
+			fg[0] += pen_cte * CppAD::pow(vars[cte_start + t], 2);
+			fg[0] += pen_angle * CppAD::pow(vars[epsi_start + t], 2);
+			fg[0] += pen_speed * CppAD::pow(vars[v_start + t] - ref_v, 2);
+		}
+
+		// Minimize the use of actuators.
+		for (unsigned int t = 0; t < N - 1; t++) {
+			fg[0] += pen_steering * CppAD::pow(vars[delta_start + t], 2);
+			fg[0] += pen_throttle * CppAD::pow(vars[a_start + t], 2);
+		}
+
+		// Minimize the value gap between sequential actuations.
+		for (unsigned int t = 0; t < N - 2; t++) {
+			fg[0] += pen_st_angle * CppAD::pow(vars[delta_start + t + 1] - vars[delta_start + t], 2);
+			fg[0] += pen_break * CppAD::pow(vars[a_start + t + 1] - vars[a_start + t], 2);
+		}
+
+		// Setup Constraints
+		// Initial constraints
+		//
+		// We add 1 to each of the starting indices due to cost being located at index 0 of `fg`.
+		// This bumps up the position of all the other values.
+		fg[1 + x_start] = vars[x_start];
+		fg[1 + y_start] = vars[y_start];
+		fg[1 + psi_start] = vars[psi_start];
+		fg[1 + v_start] = vars[v_start];
+		fg[1 + cte_start] = vars[cte_start];
+		fg[1 + epsi_start] = vars[epsi_start];
+
+		// The rest of the constraints
+		for (unsigned int t = 1; t < N; t++) {
+			// The state at time t+1 .
+			AD<double> x1 = vars[x_start + t];
+			AD<double> y1 = vars[y_start + t];
+			AD<double> psi1 = vars[psi_start + t];
+			AD<double> v1 = vars[v_start + t];
+			AD<double> cte1 = vars[cte_start + t];
+			AD<double> epsi1 = vars[epsi_start + t];
+
+			// The state at time t.
+			AD<double> x0 = vars[x_start + t - 1];
+			AD<double> y0 = vars[y_start + t - 1];
+			AD<double> psi0 = vars[psi_start + t - 1];
+			AD<double> v0 = vars[v_start + t - 1];
+			AD<double> cte0 = vars[cte_start + t - 1];
+			AD<double> epsi0 = vars[epsi_start + t - 1];
+
+			// Only consider the actuation at time t.
+			AD<double> delta0 = vars[delta_start + t - 1];
+			AD<double> a0 = vars[a_start + t - 1];
+
+			// we consider fitting third-order polynomial to the way points
+			AD<double> f0 = coeffs[0] + coeffs[1] * x0 + coeffs[2] * CppAD::pow(x0, 2) + coeffs[3] * CppAD::pow(x0, 3);
+			AD<double> psides0 = CppAD::atan(coeffs[1] + 2 * coeffs[2] * x0 + 3 * coeffs[3] * CppAD::pow(x0, 2));
+
+			// Here's `x` to get you started.
+			// The idea here is to constraint this value to be 0.
+			//
+			// Recall the equations for the model:
+			// x_[t] = x[t-1] + v[t-1] * cos(psi[t-1]) * dt
+			// y_[t] = y[t-1] + v[t-1] * sin(psi[t-1]) * dt
+			// psi_[t] = psi[t-1] + v[t-1] / Lf * delta[t-1] * dt
+			// v_[t] = v[t-1] + a[t-1] * dt
+			// cte[t] = f(x[t-1]) - y[t-1] + v[t-1] * sin(epsi[t-1]) * dt
+			// epsi[t] = psi[t] - psides[t-1] + v[t-1] * delta[t-1] / Lf * dt
+			fg[1 + x_start + t] = x1 - (x0 + v0 * CppAD::cos(psi0) * dt);
+			fg[1 + y_start + t] = y1 - (y0 + v0 * CppAD::sin(psi0) * dt);
+			fg[1 + psi_start + t] = psi1 - (psi0 - v0 / Lf * delta0 * dt); // we changed the sign to consider negative feedback
+			fg[1 + v_start + t] = v1 - (v0 + a0 * dt);
+			fg[1 + cte_start + t] = cte1 - ((f0 - y0) + (v0 * CppAD::sin(epsi0) * dt));
+			fg[1 + epsi_start + t] = epsi1 - ((psi0 - psides0) - v0 / Lf * delta0 * dt);
+		}
+	}
+};
+
+template <size_t N> constexpr size_t FG_eval<N>::n_coeffs;
+
+// Hand-written first and second derivatives of FG_eval. The model is small
+// and fixed, so every nonzero is known up front: the structure below is built
+// once and Jacobian() / Hessian() fill the values in the same order.
+// Any change to FG_eval has to be mirrored here, the CHECK derivatives mode of
+// MPC compares both against the tape.
+template <size_t N>
+class FG_derivatives : public NLP_derivatives, public MPC_layout<N> {
+public:
+	MPC_LAYOUT_USING(N);
+
+	const MPC_config config;
+
+	FG_derivatives(const MPC_config &config) : config(config) {
+		// Initial constraints
+		for (size_t start = x_start; start < delta_start; start += N) {
+			AddJacobian(start, start);
+		}
+		// The rest of the constraints, see Jacobian() for the values
+		for (unsigned int t = 1; t < N; t++) {
+			size_t k = t - 1;
+			AddJacobian(x_start + t, x_start + t);
+			AddJacobian(x_start + t, x_start + k);
+			AddJacobian(x_start + t, psi_start + k);
+			AddJacobian(x_start + t, v_start + k);
+
+			AddJacobian(y_start + t, y_start + t);
+			AddJacobian(y_start + t, y_start + k);
+			AddJacobian(y_start + t, psi_start + k);
+			AddJacobian(y_start + t, v_start + k);
+
+			AddJacobian(psi_start + t, psi_start + t);
+			AddJacobian(psi_start + t, psi_start + k);
+			AddJacobian(psi_start + t, v_start + k);
+			AddJacobian(psi_start + t, delta_start + k);
+
+			AddJacobian(v_start + t, v_start + t);
+			AddJacobian(v_start + t, v_start + k);
+			AddJacobian(v_start + t, a_start + k);
+
+			AddJacobian(cte_start + t, cte_start + t);
+			AddJacobian(cte_start + t, x_start + k);
+			AddJacobian(cte_start + t, y_start + k);
+			AddJacobian(cte_start + t, v_start + k);
+			AddJacobian(cte_start + t, epsi_start + k);
+
+			AddJacobian(epsi_start + t, epsi_start + t);
+			AddJacobian(epsi_start + t, psi_start + k);
+			AddJacobian(epsi_start + t, x_start + k);
+			AddJacobian(epsi_start + t, v_start + k);
+			AddJacobian(epsi_start + t, delta_start + k);
+		}
+
+		// Lower triangle of the Hessian of the Lagrangian, stage by stage,
+		// see Hessian() for the values
+		for (unsigned int k = 0; k < N; k++) {
+			if (k < N - 1) {
+				AddHessian(x_start + k, x_start + k);
+				AddHessian(psi_start + k, psi_start + k);
+				AddHessian(v_start + k, psi_start + k);
+			}
+			AddHessian(v_start + k, v_start + k);
+			AddHessian(cte_start + k, cte_start + k);
+			AddHessian(epsi_start + k, epsi_start + k);
+			if (k < N - 1) {
+				AddHessian(epsi_start + k, v_start + k);
+				AddHessian(delta_start + k, v_start + k);
+				AddHessian(delta_start + k, delta_start + k);
+				AddHessian(a_start + k, a_start + k);
+			}
+			if (k + 2 < N) {
+				AddHessian(delta_start + k + 1, delta_start + k);
+				AddHessian(a_start + k + 1, a_start + k);
+			}
+		}
+	}
+
+	void Gradient(const double *vars, const double *coeffs, double *grad) {
+		for (size_t i = 0; i < n_vars; i++) {
+			grad[i] = 0.0;
+		}
+		for (unsigned int t = 0; t < N; t++) {
+			grad[cte_start + t] = 2 * config.pen_cte * vars[cte_start + t];
+			grad[epsi_start + t] = 2 * config.pen_angle * vars[epsi_start + t];
+			grad[v_start + t] = 2 * config.pen_speed * (vars[v_start + t] - config.ref_v);
+		}
+		for (unsigned int t = 0; t < N - 1; t++) {
+			grad[delta_start + t] = 2 * config.pen_steering * vars[delta_start + t];
+			grad[a_start + t] = 2 * config.pen_throttle * vars[a_start + t];
+		}
+		for (unsigned int t = 0; t + 2 < N; t++) {
+			double d_delta = 2 * config.pen_st_angle * (vars[delta_start + t + 1] - vars[delta_start + t]);
+			grad[delta_start + t + 1] += d_delta;
+			grad[delta_start + t] -= d_delta;
+			double d_a = 2 * config.pen_break * (vars[a_start + t + 1] - vars[a_start + t]);
+			grad[a_start + t + 1] += d_a;
+			grad[a_start + t] -= d_a;
+		}
+	}
+
+	void Jacobian(const double *vars, const double *coeffs, double *values) {
+		const double dt = config.dt;
+		const double Lf = config.Lf;
+		double *out = values;
+		for (size_t start = x_start; start < delta_start; start += N) {
+			*out++ = 1.0;
+		}
+		for (unsigned int t = 1; t < N; t++) {
+			size_t k = t - 1;
+			double x0 = vars[x_start + k];
+			double psi0 = vars[psi_start + k];
+			double v0 = vars[v_start + k];
+			double epsi0 = vars[epsi_start + k];
+			double delta0 = vars[delta_start + k];
+			double cos_psi = cos(psi0);
+			double sin_psi = sin(psi0);
+			// f' and f'' of the reference polynomial at x0
+			double df = coeffs[1] + 2 * coeffs[2] * x0 + 3 * coeffs[3] * x0 * x0;
+			double ddf = 2 * coeffs[2] + 6 * coeffs[3] * x0;
+
+			// x1 - (x0 + v0 * cos(psi0) * dt)
+			*out++ = 1.0;
+			*out++ = -1.0;
+			*out++ = v0 * sin_psi * dt;
+			*out++ = -cos_psi * dt;
+			// y1 - (y0 + v0 * sin(psi0) * dt)
+			*out++ = 1.0;
+			*out++ = -1.0;
+			*out++ = -v0 * cos_psi * dt;
+			*out++ = -sin_psi * dt;
+			// psi1 - (psi0 - v0 / Lf * delta0 * dt)
+			*out++ = 1.0;
+			*out++ = -1.0;
+			*out++ = delta0 / Lf * dt;
+			*out++ = v0 / Lf * dt;
+			// v1 - (v0 + a0 * dt)
+			*out++ = 1.0;
+			*out++ = -1.0;
+			*out++ = -dt;
+			// cte1 - ((f(x0) - y0) + v0 * sin(epsi0) * dt)
+			*out++ = 1.0;
+			*out++ = -df;
+			*out++ = 1.0;
+			*out++ = -sin(epsi0) * dt;
+			*out++ = -v0 * cos(epsi0) * dt;
+			// epsi1 - ((psi0 - atan(f'(x0))) - v0 / Lf * delta0 * dt)
+			*out++ = 1.0;
+			*out++ = -1.0;
+			*out++ = ddf / (1 + df * df);
+			*out++ = delta0 / Lf * dt;
+			*out++ = v0 / Lf * dt;
+		}
+	}
+
+	void Hessian(const double *vars, const double *coeffs, double obj_factor, const double *lambda,
+		double *values) {
+		const double dt = config.dt;
+		const double Lf = config.Lf;
+		double *out = values;
+		for (unsigned int k = 0; k < N; k++) {
+			// Multipliers of the constraints linking stage k to stage k + 1
+			double l_x = 0, l_y = 0, l_psi = 0, l_cte = 0, l_epsi = 0;
+			double x0 = vars[x_start + k];
+			double psi0 = vars[psi_start + k];
+			double v0 = vars[v_start + k];
+			double epsi0 = vars[epsi_start + k];
+			if (k < N - 1) {
+				l_x = lambda[x_start + k + 1];
+				l_y = lambda[y_start + k + 1];
+				l_psi = lambda[psi_start + k + 1];
+				l_cte = lambda[cte_start + k + 1];
+				l_epsi = lambda[epsi_start + k + 1];
+
+				double cos_psi = cos(psi0);
+				double sin_psi = sin(psi0);
+				double df = coeffs[1] + 2 * coeffs[2] * x0 + 3 * coeffs[3] * x0 * x0;
+				double ddf = 2 * coeffs[2] + 6 * coeffs[3] * x0;
+				double dddf = 6 * coeffs[3];
+				double q = 1 + df * df;
+				// (x, x): -f''(x0) in cte, d^2 atan(f'(x0)) / dx0^2 in epsi
+				*out++ = -l_cte * ddf + l_epsi * (dddf / q - 2 * df * ddf * ddf / (q * q));
+				// (psi, psi)
+				*out++ = l_x * v0 * cos_psi * dt + l_y * v0 * sin_psi * dt;
+				// (v, psi)
+				*out++ = l_x * sin_psi * dt - l_y * cos_psi * dt;
+			}
+			// (v, v), (cte, cte), (epsi, epsi)
+			*out++ = obj_factor * 2 * config.pen_speed;
+			*out++ = obj_factor * 2 * config.pen_cte;
+			*out++ = obj_factor * 2 * config.pen_angle + l_cte * v0 * sin(epsi0) * dt;
+			if (k < N - 1) {
+				// (epsi, v)
+				*out++ = -l_cte * cos(epsi0) * dt;
+				// (delta, v)
+				*out++ = (l_psi + l_epsi) * dt / Lf;
+				// (delta, delta), (a, a): own weight plus one rate term per
+				// neighbour
+				double neighbours = (k > 0) + (k + 2 < N);
+				*out++ = obj_factor * 2 * (config.pen_steering + neighbours * config.pen_st_angle);
+				*out++ = obj_factor * 2 * (config.pen_throttle + neighbours * config.pen_break);
+			}
+			if (k + 2 < N) {
+				// (delta_k+1, delta_k), (a_k+1, a_k)
+				*out++ = -obj_factor * 2 * config.pen_st_angle;
+				*out++ = -obj_factor * 2 * config.pen_break;
+			}
+		}
+	}
+
+private:
+	void AddJacobian(size_t row, size_t col) {
+		jac_row.push_back(row);
+		jac_col.push_back(col);
+	}
+
+	void AddHessian(size_t row, size_t col) {
+		hes_row.push_back(row);
+		hes_col.push_back(col);
+	}
+};
+
+#endif  // FG_EVAL_H
@@ -1,19 +1,106 @@
 #ifndef MPC_H
 #define MPC_H
 
+#include <cstddef>
+#include <memory>
 #include <vector>
+#include <coin/IpSmartPtr.hpp>
 #include "Eigen-3.3/Eigen/Core"
+#include "MPC_config.h"
+#include "MPC_layout.h"
+#include "MPC_solution.h"
 
-class MPC {
+class MPC_nlp;
+class Fallback_plan;
+template <std::size_t N>
+class MPC_rti;
+namespace Ipopt {
+class IpoptApplication;
+}
+
+// Prepares CppAD for MPC instances that record and solve on up to
+// `num_threads` threads at once (the calling thread included). Call it once
+// from the main thread before any other thread touches an MPC, and while no
+// MPC_thread exists. MPC instances share no mutable state, but the linear
+// solver Ipopt is built with has to be reentrant too.
+void MPC_parallel_setup(std::size_t num_threads);
+
+// Gives the calling thread its number for CppAD, `num` in
+// [1, num_threads) of MPC_parallel_setup, while it exists; the thread that
+// called MPC_parallel_setup is 0. Every other thread that uses an MPC holds
+// one for as long as it does, including the destruction of its MPC, and no
+// two at once have the same number. A number is free again once its
+// MPC_thread is gone, so successive batches of threads can reuse them.
+class MPC_thread {
+ public:
+  explicit MPC_thread(std::size_t num);
+  ~MPC_thread();
+
+  MPC_thread(const MPC_thread &) = delete;
+  MPC_thread &operator=(const MPC_thread &) = delete;
+};
+
+// Model predictive controller with a horizon of N steps fixed at compile time.
+// MPC.cpp instantiates it for the horizons listed there.
+template <std::size_t N>
+class MPC : public MPC_layout<N> {
  public:
-  MPC();
+  MPC_LAYOUT_USING(N);
+
+  // [x, y, psi, v, cte, epsi]
+  typedef Eigen::Matrix<double, 6, 1> State;
+  // Cubic reference polynomial, lowest order first.
+  typedef Eigen::Matrix<double, 4, 1> Coeffs;
+
+  explicit MPC(const MPC_config &config = MPC_config());
 
   virtual ~MPC();
 
   // Solve the model given an initial state and polynomial coefficients.
-  // Return the first actuations.
-  std::vector<double> Solve(const Eigen::VectorXd &state, 
-                            const Eigen::VectorXd &coeffs);
+  // Returns the predicted trajectories and how the solve went, see
+  // MPC_solution; the same object every time, overwritten by the next call.
+  // With MPC_engine::RTI a solve does not allocate once the first one is
+  // done; Ipopt allocates its iterates internally on every solve.
+  //
+  // The solve stops at `deadline` (checked once per iteration) with the best
+  // feasible iterate. Without one, the inputs of the last feasible plan
+  // moved one step along the horizon are rolled out from `state` instead,
+  // see MPC_status::FALLBACK.
+  const MPC_solution<N> &Solve(const State &state, const Coeffs &coeffs,
+                               MPC_clock::time_point deadline = MPC_clock::time_point::max());
+
+  // Forgets the last solution, so the next Solve starts cold and has no plan
+  // to fall back on. For when the car was driven without solving in between,
+  // e.g. from the policy table: the last solution is in the car frame of an
+  // older message and no longer one step behind.
+  void ResetWarmStart();
+
+  // Number of Ipopt (or QP, with MPC_engine::RTI) iterations used by the
+  // last solve.
+  int Iterations() const { return solution->iterations; }
+
+  // Largest difference between the hand-written and the CppAD derivatives
+  // seen so far, with MPC_derivatives::CHECK.
+  double DerivativeError() const;
+
+  const MPC_config &config() const { return config_; }
+
+ private:
+  const MPC_config config_;
+  // Returned by Solve, viewing nlp->vars or plan_vars.
+  std::unique_ptr<MPC_solution<N>> solution;
+
+  // Cost and constraints, recorded once at construction.
+  Ipopt::SmartPtr<MPC_nlp> nlp;
+  // Solver, initialized once and reoptimized on every call to Solve.
+  Ipopt::SmartPtr<Ipopt::IpoptApplication> app;
+  bool optimized;
+  std::unique_ptr<Fallback_plan> fallback;
+
+  // Used instead of the above with MPC_engine::RTI, with its plan copied
+  // into the layout of nlp->vars.
+  std::unique_ptr<MPC_rti<N>> rti;
+  std::vector<double> plan_vars;
 };
 
 #endif  // MPC_H
@@ -0,0 +1,131 @@
+#ifndef MPC_CONFIG_H
+#define MPC_CONFIG_H
+
+#include <cstring>
+
+// Where the solver gets the first and second derivatives of the NLP from.
+enum class MPC_derivatives {
+  // CppAD sparse forward / reverse sweeps over the recorded tape.
+  CPPAD,
+  // Hand-written kernels for the kinematic bicycle model, see FG_derivatives.
+  ANALYTIC,
+  // ANALYTIC, cross-checked against CPPAD on every evaluation.
+  CHECK
+};
+
+// Which solver computes the actuations.
+enum class MPC_engine {
+  // The full nonlinear program, solved to convergence by Ipopt.
+  IPOPT,
+  // Real-time iteration: one Gauss-Newton SQP step per control cycle, see
+  // MPC_rti. That is linear time-varying MPC: the model and the reference
+  // are linearized along the previous plan and one convex QP is solved.
+  RTI
+};
+
+// How the RTI engine solves its quadratic program.
+enum class MPC_qp_solver {
+  // Interior point method on the dense KKT system.
+  DENSE_KKT,
+  // Interior point method on the inputs only, states eliminated, see
+  // Condensed_kkt.
+  CONDENSED,
+  // Interior point method with a Riccati recursion, linear in the horizon,
+  // see Riccati_kkt. The choice for long horizons.
+  RICCATI,
+  // Active-set method on the condensed QP, hot-started from the previous
+  // cycle's working set, see Active_set_qp.
+  ACTIVE_SET,
+  // Interior point method on the sparse KKT system, symbolic factorization
+  // computed once, see Sparse_kkt.
+  SPARSE_LDLT
+};
+
+// Every MPC_qp_solver with the name main's --qp and the tools' output use
+// for it, in the order above.
+struct MPC_qp_solver_name {
+  const char *name;
+  MPC_qp_solver solver;
+};
+
+const MPC_qp_solver_name qp_solver_names[] = {
+  {"dense", MPC_qp_solver::DENSE_KKT},
+  {"condensed", MPC_qp_solver::CONDENSED},
+  {"riccati", MPC_qp_solver::RICCATI},
+  {"active-set", MPC_qp_solver::ACTIVE_SET},
+  {"sparse", MPC_qp_solver::SPARSE_LDLT}
+};
+
+// Looks up `name` in qp_solver_names, returns false if it is none of them.
+inline bool ParseQpSolver(const char *name, MPC_qp_solver &solver) {
+  for (const MPC_qp_solver_name &entry : qp_solver_names) {
+    if (std::strcmp(entry.name, name) == 0) {
+      solver = entry.solver;
+      return true;
+    }
+  }
+  return false;
+}
+
+// Settings of one MPC instance. Every controller carries its own copy, so
+// controllers with different settings can coexist and solve concurrently.
+struct MPC_config {
+  // Duration of one step of the horizon, in seconds.
+  double dt = 0.1;
+
+  // This value assumes the model presented in the classroom is used.
+  //
+  // It was obtained by measuring the radius formed by running the vehicle in
+  //   the simulator around in a circle with a constant steering angle and
+  //   velocity on a flat terrain.
+  //
+  // Lf was tuned until the the radius formed by the simulating the model
+  //   presented in the classroom matched the previous radius.
+  //
+  // This is the length from front to CoG that has a similar radius.
+  double Lf = 2.67;
+
+  // Speed the controller tries to keep.
+  double ref_v = 100;
+
+  // Cost weights: penalizing large cte, large angle error and losing the
+  // reference speed, penalizing the use of steering and throttle, penalizing
+  // changes of the steering angle and abrupt breaks. These can be tuned.
+  double pen_cte = 2500.0;
+  double pen_angle = 2000.0;
+  double pen_speed = 1.0;
+  double pen_steering = 5.0;
+  double pen_throttle = 5.0;
+  double pen_st_angle = 200.0;
+  double pen_break = 10.0;
+
+  // The upper and lower limits of delta are set to -25 and 25 degrees
+  // (values in radians), the throttle to [-1, 1].
+  double max_steering = 0.436332;
+  double max_throttle = 1.0;
+
+  MPC_engine engine = MPC_engine::IPOPT;
+  MPC_derivatives derivatives = MPC_derivatives::ANALYTIC;
+
+  // Start every solve from the previous solution shifted one step along the
+  // horizon.
+  bool warm_start = true;
+  // NOTE: Currently the solver has a maximum time limit of 0.5 seconds.
+  // Change this as you see fit.
+  double max_cpu_time = 0.5;
+  // Largest constraint violation of an iterate that is still used when a
+  // solve stops short of convergence, e.g. at its deadline; otherwise the
+  // previous plan is, see MPC_status::FALLBACK.
+  double feasibility_tolerance = 1e-4;
+
+  // RTI engine: QP solver, its iteration limit (working set changes for
+  // ACTIVE_SET) and convergence tolerance. An iteration limit of 0 scales it
+  // with the horizon: from a cold start the active set method adds about one
+  // bound per stage, and the interior point methods need more than 30
+  // iterations at N = 100.
+  MPC_qp_solver qp_solver = MPC_qp_solver::CONDENSED;
+  int qp_max_iterations = 0;
+  double qp_tolerance = 1e-8;
+};
+
+#endif  // MPC_CONFIG_H
@@ -0,0 +1,127 @@
+#include "MPC_frenet.h"
+#include <chrono>
+#include <limits>
+#include <cppad/cppad.hpp>
+#include <coin/IpIpoptApplication.hpp>
+#include "frenet_eval.h"
+#include "MPC_nlp.h"
+
+// Shifts a vector laid out like `vars` (or like the bound multipliers).
+template <size_t N>
+static void ShiftVars(std::vector<double> &values) {
+	typedef Frenet_layout<N> L;
+	for (size_t start = L::s_start; start < L::delta_start; start += N) {
+		ShiftBlock(values, start, N);
+	}
+	ShiftBlock(values, L::delta_start, N - 1);
+	ShiftBlock(values, L::a_start, N - 1);
+}
+
+// Shifts a vector laid out like the constraints.
+template <size_t N>
+static void ShiftConstraints(std::vector<double> &values) {
+	for (size_t start = 0; start < Frenet_layout<N>::n_constraints; start += N) {
+		ShiftBlock(values, start, N);
+	}
+}
+
+template <size_t N>
+MPC_frenet<N>::MPC_frenet(const MPC_config &config) : config_(config), optimized(false) {
+	// Record the cost and constraints once, the curvatures are tape parameters.
+	Frenet_eval<N> fg_eval(config_);
+	nlp = new MPC_nlp(fg_eval, n_vars, n_constraints, Frenet_eval<N>::n_curvatures);
+
+	// The states are free, the actuators limited as in MPC.
+	for (unsigned int i = 0; i < delta_start; i++) {
+		nlp->vars_lowerbound[i] = -1.0e19;
+		nlp->vars_upperbound[i] = 1.0e19;
+	}
+	for (unsigned int i = delta_start; i < a_start; i++) {
+		nlp->vars_lowerbound[i] = -config_.max_steering;
+		nlp->vars_upperbound[i] = config_.max_steering;
+	}
+	for (unsigned int i = a_start; i < n_vars; i++) {
+		nlp->vars_lowerbound[i] = -config_.max_throttle;
+		nlp->vars_upperbound[i] = config_.max_throttle;
+	}
+
+	app = CreateIpoptApplication(config_);
+	nlp->feasibility_tolerance = config_.feasibility_tolerance;
+	fallback.reset(new Fallback_plan(n_vars, N, &ShiftVars<N>));
+	solution.reset(new Frenet_solution<N>(&nlp->vars[s_start], &nlp->vars[delta_start]));
+}
+
+template <size_t N>
+MPC_frenet<N>::~MPC_frenet() {}
+
+template <size_t N>
+const Frenet_solution<N> &MPC_frenet<N>::Solve(const State &state, const Curvatures &curvatures,
+	MPC_clock::time_point deadline) {
+	const auto start = MPC_clock::now();
+	std::vector<double> &vars = nlp->vars;
+
+	// As in MPC::Solve: start from the previous solution moved one step along
+	// the horizon after a successful solve, from 0 otherwise. The arc length
+	// jumps back by a lap at the start line, but it enters neither the cost
+	// nor the other states, so the shifted point stays good for the rest.
+	nlp->warm_start = config_.warm_start && (nlp->status == Ipopt::SUCCESS ||
+		nlp->status == Ipopt::STOP_AT_ACCEPTABLE_POINT);
+	if (nlp->warm_start) {
+		ShiftVars<N>(vars);
+		ShiftVars<N>(nlp->z_L);
+		ShiftVars<N>(nlp->z_U);
+		ShiftConstraints<N>(nlp->lambda);
+	}
+	else {
+		for (unsigned int i = 0; i < n_vars; i++) {
+			vars[i] = 0;
+		}
+	}
+
+	// The initial state is fixed by its constraints, the dynamics are 0.
+	const size_t starts[4] = {s_start, ey_start, epsi_start, v_start};
+	for (unsigned int i = 0; i < n_constraints; i++) {
+		nlp->constraints_lowerbound[i] = 0;
+		nlp->constraints_upperbound[i] = 0;
+	}
+	for (int i = 0; i < 4; i++) {
+		vars[starts[i]] = state[i];
+		nlp->constraints_lowerbound[starts[i]] = state[i];
+		nlp->constraints_upperbound[starts[i]] = state[i];
+	}
+
+	nlp->SetParams(curvatures.data());
+
+	// As in MPC::Solve.
+	if (MPC_clock::now() < deadline) {
+		nlp->deadline = deadline;
+		solution->iterations = OptimizeNlp(*app, nlp, optimized);
+	}
+	else {
+		nlp->status = Ipopt::USER_REQUESTED_STOP;
+		nlp->feasible = false;
+		solution->iterations = 0;
+	}
+	solution->status = IpoptStatus(nlp->status, nlp->feasible);
+	solution->objective = nlp->obj_value;
+	if (nlp->feasible) {
+		fallback->Store(vars);
+	}
+	else if (fallback->Take(vars)) {
+		solution->status = MPC_status::FALLBACK;
+		solution->objective = std::numeric_limits<double>::quiet_NaN();
+	}
+	else {
+		solution->status = MPC_status::FAILED;
+	}
+	solution->degraded_cycles += solution->Degraded();
+	solution->solve_time = std::chrono::duration<double>(MPC_clock::now() - start).count();
+	return *solution;
+}
+
+// Horizons used in practice; add an instantiation here to use another one.
+template class MPC_frenet<10>;
+template class MPC_frenet<20>;
+template class MPC_frenet<40>;
+template class MPC_frenet<50>;
+template class MPC_frenet<100>;
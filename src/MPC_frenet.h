@@ -0,0 +1,61 @@
+#ifndef MPC_FRENET_H
+#define MPC_FRENET_H
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+#include <coin/IpSmartPtr.hpp>
+#include "Eigen-3.3/Eigen/Core"
+#include "MPC_config.h"
+#include "MPC_layout.h"
+#include "MPC_solution.h"
+
+class MPC_nlp;
+class Fallback_plan;
+namespace Ipopt {
+class IpoptApplication;
+}
+
+// Model predictive controller in path coordinates, see Frenet_eval: the
+// reference is the center line of a Track given by its curvature along the
+// horizon, instead of a cubic in the car frame. Solved by Ipopt from the
+// CppAD tape, recorded once, with the same settings and warm starts as MPC.
+// MPC_frenet.cpp instantiates it for the horizons listed there.
+template <std::size_t N>
+class MPC_frenet : public Frenet_layout<N> {
+ public:
+  FRENET_LAYOUT_USING(N);
+
+  // [s, ey, epsi, v]
+  typedef Eigen::Matrix<double, 4, 1> State;
+  // Center line curvature at the start of each step of the horizon.
+  typedef Eigen::Matrix<double, N - 1, 1> Curvatures;
+
+  explicit MPC_frenet(const MPC_config &config = MPC_config());
+
+  virtual ~MPC_frenet();
+
+  // Solve the model given an initial state and the curvatures ahead. Returns
+  // the predicted trajectories as MPC::Solve does, in path coordinates, and
+  // stops at `deadline` the same way. A FALLBACK plan keeps its states, which
+  // do not depend on the car frame here.
+  const Frenet_solution<N> &Solve(const State &state, const Curvatures &curvatures,
+                                  MPC_clock::time_point deadline = MPC_clock::time_point::max());
+
+  // Number of Ipopt iterations used by the last solve.
+  int Iterations() const { return solution->iterations; }
+
+  const MPC_config &config() const { return config_; }
+
+ private:
+  const MPC_config config_;
+  // Returned by Solve, viewing nlp->vars.
+  std::unique_ptr<Frenet_solution<N>> solution;
+
+  Ipopt::SmartPtr<MPC_nlp> nlp;
+  Ipopt::SmartPtr<Ipopt::IpoptApplication> app;
+  bool optimized;
+  std::unique_ptr<Fallback_plan> fallback;
+};
+
+#endif  // MPC_FRENET_H
@@ -0,0 +1,94 @@
+#ifndef MPC_LAYOUT_H
+#define MPC_LAYOUT_H
+
+#include <cstddef>
+
+// Position of every state and actuator block in the Ipopt vars vector for a
+// horizon of N steps. The states are stored block by block ([x_0 .. x_N-1],
+// [y_0 .. y_N-1], ...) followed by the N - 1 steering angles and the N - 1
+// accelerations. The constraints use the same order as the states.
+template <std::size_t N>
+struct MPC_layout {
+  static_assert(N >= 2, "the horizon needs at least one actuation");
+
+  static constexpr std::size_t horizon = N;
+  static constexpr std::size_t x_start = 0;
+  static constexpr std::size_t y_start = x_start + N;
+  static constexpr std::size_t psi_start = y_start + N;
+  static constexpr std::size_t v_start = psi_start + N;
+  static constexpr std::size_t cte_start = v_start + N;
+  static constexpr std::size_t epsi_start = cte_start + N;
+  static constexpr std::size_t delta_start = epsi_start + N;
+  static constexpr std::size_t a_start = delta_start + N - 1;
+
+  static constexpr std::size_t n_vars = N * 6 + (N - 1) * 2;
+  static constexpr std::size_t n_constraints = N * 6;
+};
+
+template <std::size_t N> constexpr std::size_t MPC_layout<N>::horizon;
+template <std::size_t N> constexpr std::size_t MPC_layout<N>::x_start;
+template <std::size_t N> constexpr std::size_t MPC_layout<N>::y_start;
+template <std::size_t N> constexpr std::size_t MPC_layout<N>::psi_start;
+template <std::size_t N> constexpr std::size_t MPC_layout<N>::v_start;
+template <std::size_t N> constexpr std::size_t MPC_layout<N>::cte_start;
+template <std::size_t N> constexpr std::size_t MPC_layout<N>::epsi_start;
+template <std::size_t N> constexpr std::size_t MPC_layout<N>::delta_start;
+template <std::size_t N> constexpr std::size_t MPC_layout<N>::a_start;
+template <std::size_t N> constexpr std::size_t MPC_layout<N>::n_vars;
+template <std::size_t N> constexpr std::size_t MPC_layout<N>::n_constraints;
+
+// Brings the block offsets of MPC_layout<N> into a class template deriving
+// from it, so member functions can use them unqualified.
+#define MPC_LAYOUT_USING(N)                  \
+  using MPC_layout<N>::x_start;              \
+  using MPC_layout<N>::y_start;              \
+  using MPC_layout<N>::psi_start;            \
+  using MPC_layout<N>::v_start;              \
+  using MPC_layout<N>::cte_start;            \
+  using MPC_layout<N>::epsi_start;           \
+  using MPC_layout<N>::delta_start;          \
+  using MPC_layout<N>::a_start;              \
+  using MPC_layout<N>::n_vars;               \
+  using MPC_layout<N>::n_constraints
+
+// The same for the path coordinate model of Frenet_eval: arc length along
+// the center line, lateral offset from it, heading error and speed, followed
+// by the actuations as above.
+template <std::size_t N>
+struct Frenet_layout {
+  static_assert(N >= 2, "the horizon needs at least one actuation");
+
+  static constexpr std::size_t horizon = N;
+  static constexpr std::size_t s_start = 0;
+  static constexpr std::size_t ey_start = s_start + N;
+  static constexpr std::size_t epsi_start = ey_start + N;
+  static constexpr std::size_t v_start = epsi_start + N;
+  static constexpr std::size_t delta_start = v_start + N;
+  static constexpr std::size_t a_start = delta_start + N - 1;
+
+  static constexpr std::size_t n_vars = N * 4 + (N - 1) * 2;
+  static constexpr std::size_t n_constraints = N * 4;
+};
+
+template <std::size_t N> constexpr std::size_t Frenet_layout<N>::horizon;
+template <std::size_t N> constexpr std::size_t Frenet_layout<N>::s_start;
+template <std::size_t N> constexpr std::size_t Frenet_layout<N>::ey_start;
+template <std::size_t N> constexpr std::size_t Frenet_layout<N>::epsi_start;
+template <std::size_t N> constexpr std::size_t Frenet_layout<N>::v_start;
+template <std::size_t N> constexpr std::size_t Frenet_layout<N>::delta_start;
+template <std::size_t N> constexpr std::size_t Frenet_layout<N>::a_start;
+template <std::size_t N> constexpr std::size_t Frenet_layout<N>::n_vars;
+template <std::size_t N> constexpr std::size_t Frenet_layout<N>::n_constraints;
+
+// MPC_LAYOUT_USING for Frenet_layout<N>.
+#define FRENET_LAYOUT_USING(N)               \
+  using Frenet_layout<N>::s_start;           \
+  using Frenet_layout<N>::ey_start;          \
+  using Frenet_layout<N>::epsi_start;        \
+  using Frenet_layout<N>::v_start;           \
+  using Frenet_layout<N>::delta_start;       \
+  using Frenet_layout<N>::a_start;           \
+  using Frenet_layout<N>::n_vars;            \
+  using Frenet_layout<N>::n_constraints
+
+#endif  // MPC_LAYOUT_H
@@ -0,0 +1,444 @@
+#include "MPC_nlp.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <map>
+#include <utility>
+
+using Ipopt::Index;
+using Ipopt::Number;
+
+void MPC_nlp::Allocate() {
+	vars.assign(n_vars, 0.0);
+	vars_lowerbound.assign(n_vars, 0.0);
+	vars_upperbound.assign(n_vars, 0.0);
+	constraints_lowerbound.assign(n_constraints, 0.0);
+	constraints_upperbound.assign(n_constraints, 0.0);
+	z_L.assign(n_vars, 0.0);
+	z_U.assign(n_vars, 0.0);
+	lambda.assign(n_constraints, 0.0);
+	warm_start = false;
+
+	xp.assign(n_vars + n_params, 0.0);
+	fg.assign(1 + n_constraints, 0.0);
+	fg_valid = false;
+	w.assign(1 + n_constraints, 0.0);
+
+	deadline = MPC_clock::time_point::max();
+	feasibility_tolerance = 0.0;
+	best_vars.assign(n_vars, 0.0);
+	best_obj = std::numeric_limits<double>::infinity();
+
+	status = Ipopt::UNASSIGNED;
+	obj_value = 0.0;
+	feasible = false;
+
+	check = false;
+	derivative_error = 0.0;
+}
+
+void MPC_nlp::ComputeSparsity() {
+	size_t n = n_vars + n_params;
+
+	// Jacobian of [cost, constraints] with respect to all independents.
+	Pattern r(n);
+	for (size_t j = 0; j < n; j++) {
+		r[j].insert(j);
+	}
+	jac_pattern = tape.ForSparseJac(n, r);
+
+	// Ipopt only needs the constraint rows and the vars columns.
+	for (size_t i = 1; i <= n_constraints; i++) {
+		for (std::set<size_t>::const_iterator it = jac_pattern[i].begin(); it != jac_pattern[i].end(); ++it) {
+			if (*it < n_vars) {
+				jac_row.push_back(i);
+				jac_col.push_back(*it);
+			}
+		}
+	}
+	jac.assign(jac_row.size(), 0.0);
+
+	// Hessian of the Lagrangian, i.e. of every range component.
+	Pattern s(1);
+	for (size_t i = 0; i <= n_constraints; i++) {
+		s[0].insert(i);
+	}
+	hes_pattern = tape.RevSparseHes(n, s);
+
+	// Lower triangle of the vars block.
+	for (size_t i = 0; i < n_vars; i++) {
+		for (std::set<size_t>::const_iterator it = hes_pattern[i].begin(); it != hes_pattern[i].end(); ++it) {
+			if (*it <= i) {
+				hes_row.push_back(i);
+				hes_col.push_back(*it);
+			}
+		}
+	}
+	hes.assign(hes_row.size(), 0.0);
+}
+
+void MPC_nlp::SetDerivatives(NLP_derivatives *derivatives, bool check) {
+	this->derivatives.reset(derivatives);
+	this->check = check;
+	derivative_error = 0.0;
+	if (check) {
+		jac_check.Build(jac_row, jac_col, 1, derivatives->jac_row, derivatives->jac_col);
+		hes_check.Build(hes_row, hes_col, 0, derivatives->hes_row, derivatives->hes_col);
+	}
+}
+
+void MPC_nlp::CheckMap::Build(const std::vector<size_t> &tape_row, const std::vector<size_t> &tape_col,
+	size_t tape_row_offset, const std::vector<size_t> &row, const std::vector<size_t> &col) {
+	std::map<std::pair<size_t, size_t>, size_t> index;
+	for (size_t k = 0; k < row.size(); k++) {
+		index[std::make_pair(row[k], col[k])] = k;
+	}
+	std::vector<bool> matched(row.size(), false);
+	tape_to_derivatives.assign(tape_row.size(), -1);
+	for (size_t k = 0; k < tape_row.size(); k++) {
+		std::map<std::pair<size_t, size_t>, size_t>::const_iterator it =
+			index.find(std::make_pair(tape_row[k] - tape_row_offset, tape_col[k]));
+		if (it != index.end()) {
+			tape_to_derivatives[k] = it->second;
+			matched[it->second] = true;
+		}
+	}
+	derivatives_only.clear();
+	for (size_t k = 0; k < row.size(); k++) {
+		if (!matched[k]) {
+			derivatives_only.push_back(k);
+		}
+	}
+}
+
+double MPC_nlp::CheckMap::MaxError(const std::vector<double> &tape, const double *values) const {
+	double error = 0.0;
+	for (size_t k = 0; k < tape.size(); k++) {
+		double value = tape_to_derivatives[k] < 0 ? 0.0 : values[tape_to_derivatives[k]];
+		error = std::max(error, std::fabs(tape[k] - value));
+	}
+	for (size_t k = 0; k < derivatives_only.size(); k++) {
+		error = std::max(error, std::fabs(values[derivatives_only[k]]));
+	}
+	return error;
+}
+
+void MPC_nlp::SetParams(const double *p) {
+	for (size_t i = 0; i < n_params; i++) {
+		xp[n_vars + i] = p[i];
+	}
+	fg_valid = false;
+}
+
+void MPC_nlp::Forward0(const Number *x, bool new_x) {
+	if (new_x || !fg_valid) {
+		for (size_t i = 0; i < n_vars; i++) {
+			xp[i] = x[i];
+		}
+		fg = tape.Forward(0, xp);
+		fg_valid = true;
+		KeepIfBest();
+	}
+}
+
+void MPC_nlp::KeepIfBest() {
+	if (!(fg[0] < best_obj)) {
+		return;
+	}
+	for (size_t i = 0; i < n_vars; i++) {
+		if (xp[i] < vars_lowerbound[i] - feasibility_tolerance || xp[i] > vars_upperbound[i] + feasibility_tolerance) {
+			return;
+		}
+	}
+	for (size_t i = 0; i < n_constraints; i++) {
+		if (fg[1 + i] < constraints_lowerbound[i] - feasibility_tolerance ||
+			fg[1 + i] > constraints_upperbound[i] + feasibility_tolerance) {
+			return;
+		}
+	}
+	for (size_t i = 0; i < n_vars; i++) {
+		best_vars[i] = xp[i];
+	}
+	best_obj = fg[0];
+}
+
+bool MPC_nlp::get_nlp_info(Index &n, Index &m, Index &nnz_jac_g, Index &nnz_h_lag, IndexStyleEnum &index_style) {
+	n = n_vars;
+	m = n_constraints;
+	nnz_jac_g = derivatives ? derivatives->jac_row.size() : jac_row.size();
+	nnz_h_lag = derivatives ? derivatives->hes_row.size() : hes_row.size();
+	index_style = C_STYLE;
+	return true;
+}
+
+bool MPC_nlp::get_bounds_info(Index n, Number *x_l, Number *x_u, Index m, Number *g_l, Number *g_u) {
+	for (Index i = 0; i < n; i++) {
+		x_l[i] = vars_lowerbound[i];
+		x_u[i] = vars_upperbound[i];
+	}
+	for (Index i = 0; i < m; i++) {
+		g_l[i] = constraints_lowerbound[i];
+		g_u[i] = constraints_upperbound[i];
+	}
+	return true;
+}
+
+bool MPC_nlp::get_starting_point(Index n, bool init_x, Number *x, bool init_z, Number *z_L, Number *z_U,
+	Index m, bool init_lambda, Number *lambda) {
+	// A new solve starts.
+	best_obj = std::numeric_limits<double>::infinity();
+	if (init_x) {
+		for (Index i = 0; i < n; i++) {
+			x[i] = vars[i];
+		}
+	}
+	if (init_z) {
+		if (!warm_start) {
+			return false;
+		}
+		for (Index i = 0; i < n; i++) {
+			z_L[i] = this->z_L[i];
+			z_U[i] = this->z_U[i];
+		}
+	}
+	if (init_lambda) {
+		if (!warm_start) {
+			return false;
+		}
+		for (Index i = 0; i < m; i++) {
+			lambda[i] = this->lambda[i];
+		}
+	}
+	return true;
+}
+
+bool MPC_nlp::eval_f(Index n, const Number *x, bool new_x, Number &obj_value) {
+	Forward0(x, new_x);
+	obj_value = fg[0];
+	return true;
+}
+
+bool MPC_nlp::eval_grad_f(Index n, const Number *x, bool new_x, Number *grad_f) {
+	if (derivatives) {
+		derivatives->Gradient(x, &xp[n_vars], grad_f);
+		if (!check) {
+			return true;
+		}
+	}
+
+	// The sparse drivers below overwrite the tape's zero order results, so
+	// always sweep forward before the reverse sweep.
+	for (size_t i = 0; i < n_vars; i++) {
+		xp[i] = x[i];
+	}
+	fg = tape.Forward(0, xp);
+	fg_valid = true;
+	KeepIfBest();
+
+	for (size_t i = 0; i < w.size(); i++) {
+		w[i] = 0.0;
+	}
+	w[0] = 1.0;
+	std::vector<double> dw = tape.Reverse(1, w);
+	if (derivatives) {
+		for (Index i = 0; i < n; i++) {
+			derivative_error = std::max(derivative_error, std::fabs(dw[i] - grad_f[i]));
+		}
+		return true;
+	}
+	for (Index i = 0; i < n; i++) {
+		grad_f[i] = dw[i];
+	}
+	return true;
+}
+
+bool MPC_nlp::eval_g(Index n, const Number *x, bool new_x, Index m, Number *g) {
+	Forward0(x, new_x);
+	for (Index i = 0; i < m; i++) {
+		g[i] = fg[1 + i];
+	}
+	return true;
+}
+
+bool MPC_nlp::eval_jac_g(Index n, const Number *x, bool new_x, Index m, Index nele_jac, Index *iRow,
+	Index *jCol, Number *values) {
+	if (values == NULL) {
+		for (Index k = 0; k < nele_jac; k++) {
+			if (derivatives) {
+				iRow[k] = derivatives->jac_row[k];
+				jCol[k] = derivatives->jac_col[k];
+			}
+			else {
+				iRow[k] = jac_row[k] - 1;
+				jCol[k] = jac_col[k];
+			}
+		}
+		return true;
+	}
+
+	if (derivatives) {
+		derivatives->Jacobian(x, &xp[n_vars], values);
+		if (!check) {
+			return true;
+		}
+	}
+
+	for (size_t i = 0; i < n_vars; i++) {
+		xp[i] = x[i];
+	}
+	tape.SparseJacobianForward(xp, jac_pattern, jac_row, jac_col, jac, jac_work);
+	fg_valid = false;
+	if (derivatives) {
+		derivative_error = std::max(derivative_error, jac_check.MaxError(jac, values));
+		return true;
+	}
+	for (Index k = 0; k < nele_jac; k++) {
+		values[k] = jac[k];
+	}
+	return true;
+}
+
+bool MPC_nlp::eval_h(Index n, const Number *x, bool new_x, Number obj_factor, Index m, const Number *lambda,
+	bool new_lambda, Index nele_hess, Index *iRow, Index *jCol, Number *values) {
+	if (values == NULL) {
+		for (Index k = 0; k < nele_hess; k++) {
+			iRow[k] = derivatives ? derivatives->hes_row[k] : hes_row[k];
+			jCol[k] = derivatives ? derivatives->hes_col[k] : hes_col[k];
+		}
+		return true;
+	}
+
+	if (derivatives) {
+		derivatives->Hessian(x, &xp[n_vars], obj_factor, lambda, values);
+		if (!check) {
+			return true;
+		}
+	}
+
+	for (size_t i = 0; i < n_vars; i++) {
+		xp[i] = x[i];
+	}
+	w[0] = obj_factor;
+	for (Index i = 0; i < m; i++) {
+		w[1 + i] = lambda[i];
+	}
+	tape.SparseHessian(xp, w, hes_pattern, hes_row, hes_col, hes, hes_work);
+	fg_valid = false;
+	if (derivatives) {
+		derivative_error = std::max(derivative_error, hes_check.MaxError(hes, values));
+		return true;
+	}
+	for (Index k = 0; k < nele_hess; k++) {
+		values[k] = hes[k];
+	}
+	return true;
+}
+
+void MPC_nlp::finalize_solution(Ipopt::SolverReturn status, Index n, const Number *x, const Number *z_L,
+	const Number *z_U, Index m, const Number *g, const Number *lambda, Number obj_value,
+	const Ipopt::IpoptData *ip_data, Ipopt::IpoptCalculatedQuantities *ip_cq) {
+	// Short of convergence the last iterate may violate the constraints by
+	// any amount, so it is replaced by the best feasible point.
+	const bool converged = status == Ipopt::SUCCESS || status == Ipopt::STOP_AT_ACCEPTABLE_POINT;
+	const bool use_best = !converged && best_obj < std::numeric_limits<double>::infinity();
+	this->status = status;
+	this->obj_value = use_best ? best_obj : obj_value;
+	feasible = converged || use_best;
+	for (Index i = 0; i < n; i++) {
+		vars[i] = use_best ? best_vars[i] : x[i];
+		this->z_L[i] = z_L[i];
+		this->z_U[i] = z_U[i];
+	}
+	for (Index i = 0; i < m; i++) {
+		this->lambda[i] = lambda[i];
+	}
+}
+
+bool MPC_nlp::intermediate_callback(Ipopt::AlgorithmMode mode, Index iter, Number obj_value, Number inf_pr,
+	Number inf_du, Number mu, Number d_norm, Number regularization_size, Number alpha_du, Number alpha_pr,
+	Index ls_trials, const Ipopt::IpoptData *ip_data, Ipopt::IpoptCalculatedQuantities *ip_cq) {
+	// false makes Ipopt stop with USER_REQUESTED_STOP.
+	return MPC_clock::now() < deadline;
+}
+
+void ShiftBlock(std::vector<double> &values, size_t start, size_t length) {
+	for (size_t i = start; i + 1 < start + length; i++) {
+		values[i] = values[i + 1];
+	}
+}
+
+Ipopt::SmartPtr<Ipopt::IpoptApplication> CreateIpoptApplication(const MPC_config &config) {
+	//
+	// NOTE: You don't have to worry about these options
+	//
+	Ipopt::SmartPtr<Ipopt::IpoptApplication> app = new Ipopt::IpoptApplication();
+	// Uncomment this if you'd like more print information
+	app->Options()->SetIntegerValue("print_level", 0);
+	app->Options()->SetStringValue("sb", "yes");
+	app->Options()->SetNumericValue("max_cpu_time", config.max_cpu_time);
+	// Only used with warm_start_init_point: the shifted point is close to
+	// optimal, so keep it (and its multipliers) from being pushed back into
+	// the interior.
+	app->Options()->SetNumericValue("warm_start_bound_push", 1e-6);
+	app->Options()->SetNumericValue("warm_start_mult_bound_push", 1e-6);
+	app->Initialize();
+	return app;
+}
+
+int OptimizeNlp(Ipopt::IpoptApplication &app, const Ipopt::SmartPtr<MPC_nlp> &nlp, bool &optimized) {
+	// options that differ between cold and warm starts, the rest are set once
+	// in CreateIpoptApplication
+	if (nlp->warm_start) {
+		app.Options()->SetStringValue("warm_start_init_point", "yes");
+		app.Options()->SetNumericValue("mu_init", 1e-4);
+	}
+	else {
+		app.Options()->SetStringValue("warm_start_init_point", "no");
+		app.Options()->SetNumericValue("mu_init", 0.1);
+	}
+	if (optimized) {
+		app.ReOptimizeTNLP(nlp);
+	}
+	else {
+		app.OptimizeTNLP(nlp);
+		optimized = true;
+	}
+	return app.Statistics()->IterationCount();
+}
+
+MPC_status IpoptStatus(Ipopt::SolverReturn status, bool feasible) {
+	switch (status) {
+	case Ipopt::SUCCESS:
+		return MPC_status::SOLVED;
+	case Ipopt::STOP_AT_ACCEPTABLE_POINT:
+		return MPC_status::ACCEPTABLE;
+	case Ipopt::MAXITER_EXCEEDED:
+	case Ipopt::CPUTIME_EXCEEDED:
+	// only requested at the deadline
+	case Ipopt::USER_REQUESTED_STOP:
+		return MPC_status::LIMIT_REACHED;
+	default:
+		// E.g. LOCAL_INFEASIBILITY or RESTORATION_FAILURE after an iterate
+		// that was feasible: finalize_solution returns that one.
+		return feasible ? MPC_status::LIMIT_REACHED : MPC_status::FAILED;
+	}
+}
+
+Fallback_plan::Fallback_plan(size_t n_vars, size_t horizon, Shift shift)
+	: plan(n_vars, 0.0), horizon(horizon), steps_left(0), shift(shift) {}
+
+void Fallback_plan::Store(const std::vector<double> &vars) {
+	std::copy(vars.begin(), vars.end(), plan.begin());
+	// Its inputs reach horizon - 2 steps past the current one.
+	steps_left = horizon - 2;
+}
+
+bool Fallback_plan::Take(std::vector<double> &vars) {
+	if (steps_left == 0) {
+		return false;
+	}
+	shift(plan);
+	steps_left--;
+	std::copy(plan.begin(), plan.end(), vars.begin());
+	return true;
+}
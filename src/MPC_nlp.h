@@ -0,0 +1,248 @@
+#ifndef MPC_NLP_H
+#define MPC_NLP_H
+
+#include <memory>
+#include <set>
+#include <vector>
+#include <cppad/cppad.hpp>
+#include <coin/IpIpoptApplication.hpp>
+#include <coin/IpTNLP.hpp>
+#include "MPC_config.h"
+#include "MPC_solution.h"
+
+// Hand-written derivatives that replace the tape's sparse drivers. The
+// structure is fixed once the object is constructed: row and column of every
+// nonzero, with the constraint rows numbered from 0 and only the lower
+// triangle of the Hessian. `params` are the tape parameters.
+class NLP_derivatives {
+ public:
+  virtual ~NLP_derivatives() {}
+
+  std::vector<size_t> jac_row;
+  std::vector<size_t> jac_col;
+  std::vector<size_t> hes_row;
+  std::vector<size_t> hes_col;
+
+  virtual void Gradient(const double *vars, const double *params,
+                        double *grad) = 0;
+  virtual void Jacobian(const double *vars, const double *params,
+                        double *values) = 0;
+  virtual void Hessian(const double *vars, const double *params,
+                       double obj_factor, const double *lambda,
+                       double *values) = 0;
+};
+
+// Ipopt view of the MPC problem, backed by a CppAD tape that is recorded once.
+//
+// The tape maps [vars, params] to [cost, constraints]. The params (e.g. the
+// reference polynomial coefficients) are extra independent variables of the
+// tape that Ipopt never sees, so a new reference only moves the point the tape
+// is evaluated at. Recording, tape optimization and sparsity detection happen
+// in the constructor and never again.
+class MPC_nlp : public Ipopt::TNLP {
+ public:
+  typedef CPPAD_TESTVECTOR(CppAD::AD<double>) ADvector;
+
+  // Records `fg_eval(fg, vars_and_params)` with `n_vars + n_params`
+  // independent variables and `1 + n_constraints` dependent ones.
+  template <class FG>
+  MPC_nlp(FG &fg_eval, size_t n_vars, size_t n_constraints, size_t n_params)
+      : n_vars(n_vars), n_constraints(n_constraints), n_params(n_params) {
+    ADvector axp(n_vars + n_params);
+    for (size_t i = 0; i < axp.size(); i++) {
+      axp[i] = 0.0;
+    }
+    CppAD::Independent(axp);
+    ADvector afg(1 + n_constraints);
+    fg_eval(afg, axp);
+    tape.Dependent(axp, afg);
+    tape.optimize();
+
+    Allocate();
+    ComputeSparsity();
+  }
+
+  // Sets the tape parameters used by the following solves.
+  void SetParams(const double *p);
+
+  // Takes over the gradient, Jacobian and Hessian from the tape. With `check`
+  // the tape keeps being evaluated too and `derivative_error` tracks the
+  // largest difference between the two.
+  void SetDerivatives(NLP_derivatives *derivatives, bool check);
+  double derivative_error;
+
+  // Problem data for the next solve, filled in by the caller. `vars` holds the
+  // starting point before the solve and the solution after it.
+  std::vector<double> vars;
+  std::vector<double> vars_lowerbound;
+  std::vector<double> vars_upperbound;
+  std::vector<double> constraints_lowerbound;
+  std::vector<double> constraints_upperbound;
+
+  // Bound and constraint multipliers, stored by the last solve and handed
+  // back to Ipopt as the starting point when `warm_start` is set.
+  std::vector<double> z_L;
+  std::vector<double> z_U;
+  std::vector<double> lambda;
+  bool warm_start;
+
+  // Ipopt is stopped at the first iteration that ends past `deadline`,
+  // MPC_clock::time_point::max() for none. A point counts as feasible with
+  // no bound or constraint violated by more than `feasibility_tolerance`.
+  MPC_clock::time_point deadline;
+  double feasibility_tolerance;
+
+  // Outcome of the last solve. Short of convergence `vars` is the feasible
+  // point of least cost Ipopt evaluated, trial points included, and
+  // `feasible` is false if there was none.
+  Ipopt::SolverReturn status;
+  double obj_value;
+  bool feasible;
+
+  bool get_nlp_info(Ipopt::Index &n, Ipopt::Index &m, Ipopt::Index &nnz_jac_g,
+                    Ipopt::Index &nnz_h_lag, IndexStyleEnum &index_style);
+  bool get_bounds_info(Ipopt::Index n, Ipopt::Number *x_l, Ipopt::Number *x_u,
+                       Ipopt::Index m, Ipopt::Number *g_l, Ipopt::Number *g_u);
+  bool get_starting_point(Ipopt::Index n, bool init_x, Ipopt::Number *x,
+                          bool init_z, Ipopt::Number *z_L, Ipopt::Number *z_U,
+                          Ipopt::Index m, bool init_lambda,
+                          Ipopt::Number *lambda);
+  bool eval_f(Ipopt::Index n, const Ipopt::Number *x, bool new_x,
+              Ipopt::Number &obj_value);
+  bool eval_grad_f(Ipopt::Index n, const Ipopt::Number *x, bool new_x,
+                   Ipopt::Number *grad_f);
+  bool eval_g(Ipopt::Index n, const Ipopt::Number *x, bool new_x,
+              Ipopt::Index m, Ipopt::Number *g);
+  bool eval_jac_g(Ipopt::Index n, const Ipopt::Number *x, bool new_x,
+                  Ipopt::Index m, Ipopt::Index nele_jac, Ipopt::Index *iRow,
+                  Ipopt::Index *jCol, Ipopt::Number *values);
+  bool eval_h(Ipopt::Index n, const Ipopt::Number *x, bool new_x,
+              Ipopt::Number obj_factor, Ipopt::Index m,
+              const Ipopt::Number *lambda, bool new_lambda,
+              Ipopt::Index nele_hess, Ipopt::Index *iRow, Ipopt::Index *jCol,
+              Ipopt::Number *values);
+  void finalize_solution(Ipopt::SolverReturn status, Ipopt::Index n,
+                         const Ipopt::Number *x, const Ipopt::Number *z_L,
+                         const Ipopt::Number *z_U, Ipopt::Index m,
+                         const Ipopt::Number *g, const Ipopt::Number *lambda,
+                         Ipopt::Number obj_value,
+                         const Ipopt::IpoptData *ip_data,
+                         Ipopt::IpoptCalculatedQuantities *ip_cq);
+  bool intermediate_callback(Ipopt::AlgorithmMode mode, Ipopt::Index iter,
+                             Ipopt::Number obj_value, Ipopt::Number inf_pr,
+                             Ipopt::Number inf_du, Ipopt::Number mu,
+                             Ipopt::Number d_norm,
+                             Ipopt::Number regularization_size,
+                             Ipopt::Number alpha_du, Ipopt::Number alpha_pr,
+                             Ipopt::Index ls_trials,
+                             const Ipopt::IpoptData *ip_data,
+                             Ipopt::IpoptCalculatedQuantities *ip_cq);
+
+ private:
+  typedef std::vector<std::set<size_t> > Pattern;
+
+  // Maps the tape's nonzeros to the hand-written ones for the check mode.
+  struct CheckMap {
+    // Index of each tape nonzero among the hand-written ones, or -1.
+    std::vector<long> tape_to_derivatives;
+    // Hand-written nonzeros the tape does not have, which must be 0.
+    std::vector<size_t> derivatives_only;
+
+    void Build(const std::vector<size_t> &tape_row,
+               const std::vector<size_t> &tape_col, size_t tape_row_offset,
+               const std::vector<size_t> &row, const std::vector<size_t> &col);
+    double MaxError(const std::vector<double> &tape,
+                    const double *values) const;
+  };
+
+  void Allocate();
+  void ComputeSparsity();
+  // Copies x into the vars part of xp and runs a zero order sweep if needed.
+  void Forward0(const Ipopt::Number *x, bool new_x);
+  // Keeps the vars part of xp if fg is feasible and the cheapest so far.
+  void KeepIfBest();
+
+  const size_t n_vars;
+  const size_t n_constraints;
+  const size_t n_params;
+
+  CppAD::ADFun<double> tape;
+
+  // [vars, params] point the tape is evaluated at, and [cost, constraints].
+  std::vector<double> xp;
+  std::vector<double> fg;
+  bool fg_valid;
+  // Best feasible point of the current solve, best_obj is infinite if none.
+  std::vector<double> best_vars;
+  double best_obj;
+  // Weights for the reverse and Hessian sweeps.
+  std::vector<double> w;
+
+  Pattern jac_pattern;
+  std::vector<size_t> jac_row;
+  std::vector<size_t> jac_col;
+  std::vector<double> jac;
+  CppAD::sparse_jacobian_work jac_work;
+
+  Pattern hes_pattern;
+  std::vector<size_t> hes_row;
+  std::vector<size_t> hes_col;
+  std::vector<double> hes;
+  CppAD::sparse_hessian_work hes_work;
+
+  std::unique_ptr<NLP_derivatives> derivatives;
+  bool check;
+  CheckMap jac_check;
+  CheckMap hes_check;
+};
+
+// Moves a block of `length` values of a vector laid out like the vars or
+// the constraints one step along the horizon, for warm starts. The last
+// value is repeated since there is nothing to shift into its place.
+void ShiftBlock(std::vector<double> &values, size_t start, size_t length);
+
+// An IpoptApplication with the options every MPC solve uses, parsed once.
+// Sparsity patterns of the constraint Jacobian and the Lagrangian Hessian are
+// computed once when the tape is recorded (or written down in the
+// NLP_derivatives), see MPC_nlp.
+Ipopt::SmartPtr<Ipopt::IpoptApplication> CreateIpoptApplication(const MPC_config &config);
+
+// Solves `nlp` with `app`, from the warm start point if nlp->warm_start is
+// set, reusing the application (and its linear solver setup) once
+// `optimized`. Returns the number of Ipopt iterations.
+int OptimizeNlp(Ipopt::IpoptApplication &app, const Ipopt::SmartPtr<MPC_nlp> &nlp, bool &optimized);
+
+// The MPC_status for how Ipopt finished, where `feasible` is MPC_nlp::feasible:
+// short of convergence with a feasible point kept, whatever stopped Ipopt,
+// the solve is LIMIT_REACHED.
+MPC_status IpoptStatus(Ipopt::SolverReturn status, bool feasible);
+
+// The last feasible solution of an MPC_nlp, for the cycles whose solve ends
+// without one. Every such cycle moves it one step along the horizon with
+// `shift`, so its first actuations are the ones planned for that cycle,
+// until the horizon runs out.
+class Fallback_plan {
+ public:
+  typedef void (*Shift)(std::vector<double> &vars);
+
+  Fallback_plan(size_t n_vars, size_t horizon, Shift shift);
+
+  // Keeps `vars`, a feasible solution.
+  void Store(const std::vector<double> &vars);
+
+  // Moves the plan one step and copies it into `vars`. Returns false and
+  // leaves `vars` alone when there is no plan left.
+  bool Take(std::vector<double> &vars);
+
+  // Drops the plan.
+  void Clear() { steps_left = 0; }
+
+ private:
+  std::vector<double> plan;
+  const size_t horizon;
+  // Steps the plan can still be moved, 0 without a plan.
+  size_t steps_left;
+  const Shift shift;
+};
+
+#endif  // MPC_NLP_H
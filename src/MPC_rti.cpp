@@ -0,0 +1,126 @@
+#include "MPC_rti.h"
+#include <algorithm>
+#include "active_set_qp.h"
+#include "condensed_kkt.h"
+#include "dense_kkt.h"
+#include "qp_ipm.h"
+#include "riccati_kkt.h"
+#include "sparse_kkt.h"
+
+// config.qp_max_iterations, or when that is 0 the default for N: every
+// input bound added and dropped once for the active set method, which covers
+// a cold start, and for the interior point methods 30 iterations, more for
+// the longest horizons.
+template <size_t N>
+static int QpMaxIterations(const MPC_config &config) {
+	if (config.qp_max_iterations > 0) {
+		return config.qp_max_iterations;
+	}
+	if (config.qp_solver == MPC_qp_solver::ACTIVE_SET) {
+		return int(2 * Stage_qp<N>::nu * (N - 1));
+	}
+	return std::max(30, int(N) / 2);
+}
+
+template <size_t N>
+static Stage_qp_solver<N> *CreateSolver(const MPC_config &config, int max_iterations) {
+	switch (config.qp_solver) {
+	case MPC_qp_solver::ACTIVE_SET:
+		return new Active_set_qp<N>(max_iterations, config.qp_tolerance);
+	case MPC_qp_solver::SPARSE_LDLT:
+		return new Qp_ipm<N, Sparse_kkt<N>>(max_iterations, config.qp_tolerance);
+	case MPC_qp_solver::RICCATI:
+		return new Qp_ipm<N, Riccati_kkt<N>>(max_iterations, config.qp_tolerance);
+	case MPC_qp_solver::CONDENSED:
+		return new Qp_ipm<N, Condensed_kkt<N>>(max_iterations, config.qp_tolerance);
+	case MPC_qp_solver::DENSE_KKT:
+	default:
+		return new Qp_ipm<N, Dense_kkt<N>>(max_iterations, config.qp_tolerance);
+	}
+}
+
+template <size_t N>
+MPC_rti<N>::MPC_rti(const MPC_config &config)
+	: config(config), max_iterations(QpMaxIterations<N>(config)), has_plan(false), steps_left(0),
+	  iterations(0), status(MPC_status::FAILED), solver(CreateSolver<N>(config, max_iterations)) {
+	qp.SetCost(config);
+}
+
+template <size_t N>
+const Stage_trajectory<N> &MPC_rti<N>::Solve(const Bicycle_model::State &state,
+                                             const Bicycle_model::Coeffs &coeffs,
+                                             MPC_clock::time_point deadline) {
+	// Inputs of the previous plan moved one step along the horizon, the last
+	// one repeated. Without a plan start from coasting straight ahead.
+	if (has_plan) {
+		for (size_t k = 0; k + 2 < N; k++) {
+			plan.u[k] = plan.u[k + 1];
+		}
+	}
+	else {
+		for (size_t k = 0; k + 1 < N; k++) {
+			plan.u[k].setZero();
+		}
+	}
+
+	qp.Linearize(state, coeffs, config, plan);
+	shifted = plan;
+	iterations = solver->Solve(qp, plan, deadline);
+
+	// A failed solve is not carried over into the next cycle: the shifted
+	// plan is, feasible by construction, as long as it has inputs planned
+	// for this cycle, like Fallback_plan. Past that, and without a previous
+	// plan, it is only the last input held or coasting straight ahead.
+	if (!(qp.Infeasibility(plan) <= config.feasibility_tolerance)) {
+		plan = shifted;
+		if (has_plan && steps_left > 0) {
+			status = MPC_status::FALLBACK;
+			steps_left--;
+		}
+		else {
+			status = MPC_status::FAILED;
+			has_plan = false;
+		}
+		return plan;
+	}
+	if (iterations >= max_iterations || MPC_clock::now() >= deadline) {
+		status = MPC_status::LIMIT_REACHED;
+	}
+	else {
+		status = MPC_status::SOLVED;
+	}
+	has_plan = true;
+	// Its inputs reach N - 2 steps past the current one.
+	steps_left = N - 2;
+	return plan;
+}
+
+template <size_t N>
+void MPC_rti<N>::Reset() {
+	has_plan = false;
+	steps_left = 0;
+	solver->Reset();
+}
+
+template <size_t N>
+double MPC_rti<N>::Objective() const {
+	// The QP's cost leaves out the constant of the speed term.
+	double cost = N * config.pen_speed * config.ref_v * config.ref_v;
+	for (size_t k = 0; k < N; k++) {
+		cost += 0.5 * plan.x[k].dot(qp.Q.cwiseProduct(plan.x[k])) + qp.q.dot(plan.x[k]);
+	}
+	for (size_t k = 0; k + 1 < N; k++) {
+		cost += 0.5 * plan.u[k].dot(qp.R.cwiseProduct(plan.u[k]));
+	}
+	for (size_t k = 0; k + 2 < N; k++) {
+		const Bicycle_model::Input rate = plan.u[k + 1] - plan.u[k];
+		cost += 0.5 * rate.dot(qp.W.cwiseProduct(rate));
+	}
+	return cost;
+}
+
+template class MPC_rti<10>;
+template class MPC_rti<20>;
+template class MPC_rti<40>;
+template class MPC_rti<50>;
+template class MPC_rti<100>;
@@ -0,0 +1,63 @@
+#ifndef MPC_RTI_H
+#define MPC_RTI_H
+
+#include <cstddef>
+#include <memory>
+#include "Eigen-3.3/Eigen/Core"
+#include "MPC_config.h"
+#include "MPC_solution.h"
+#include "bicycle_model.h"
+#include "stage_qp.h"
+
+// Real-time iteration engine: one Gauss-Newton SQP step per control cycle.
+//
+// The previous plan is given in the car frame of the previous message, so
+// only its inputs carry over. They are shifted one step and rolled out from
+// the current state through the bicycle model; the dynamics are linearized
+// along that rollout and the resulting QP is solved once. The work per call
+// is one linearization and one bounded QP solve.
+template <std::size_t N>
+class MPC_rti {
+ public:
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+  explicit MPC_rti(const MPC_config &config);
+
+  // Returns the new plan, valid until the next call. The QP solve stops at
+  // `deadline`; if it has no feasible point by then, or fails, the plan is
+  // the previous one shifted and rolled out, which is where it started,
+  // for at most N - 2 cycles in a row (MPC_status::FALLBACK).
+  const Stage_trajectory<N> &Solve(const Bicycle_model::State &state,
+                                   const Bicycle_model::Coeffs &coeffs,
+                                   MPC_clock::time_point deadline);
+
+  // Drops the plan and the QP solver's hot start, the next Solve starts from
+  // coasting straight ahead.
+  void Reset();
+
+  // Number of QP iterations used by the last solve.
+  int Iterations() const { return iterations; }
+
+  // How the last solve ended.
+  MPC_status Status() const { return status; }
+
+  // FG_eval's cost at the plan returned by the last solve.
+  double Objective() const;
+
+ private:
+  const MPC_config &config;
+  // The QP solver's iteration limit.
+  const int max_iterations;
+  Stage_qp<N> qp;
+  Stage_trajectory<N> plan;
+  // The QP's starting point, kept for when the solve does not improve on it.
+  Stage_trajectory<N> shifted;
+  bool has_plan;
+  // Cycles the plan can still stand in for failed solves.
+  std::size_t steps_left;
+  int iterations;
+  MPC_status status;
+  std::unique_ptr<Stage_qp_solver<N>> solver;
+};
+
+#endif  // MPC_RTI_H
@@ -0,0 +1,95 @@
+#ifndef MPC_SOLUTION_H
+#define MPC_SOLUTION_H
+
+#include <chrono>
+#include <cstddef>
+#include "Eigen-3.3/Eigen/Core"
+
+// Clock of solve deadlines.
+typedef std::chrono::steady_clock MPC_clock;
+
+// How a solve ended.
+enum class MPC_status {
+  // Converged to the solver's tolerance.
+  SOLVED,
+  // Ipopt stopped at a point that only meets its acceptable tolerances.
+  ACCEPTABLE,
+  // Short of convergence, e.g. out of iterations, past the deadline or
+  // after Ipopt failed otherwise; the trajectories are the best feasible
+  // iterate.
+  LIMIT_REACHED,
+  // No feasible iterate: the trajectories are the last feasible plan moved
+  // one step along the horizon per cycle since.
+  FALLBACK,
+  // No usable result, e.g. Ipopt failed or the QP came out non-finite, and
+  // no plan to fall back on.
+  FAILED
+};
+
+// What every controller reports about its last solve.
+struct MPC_solve_info {
+  MPC_solve_info()
+      : status(MPC_status::FAILED), iterations(0), objective(0.0), solve_time(0.0), degraded_cycles(0) {}
+
+  // Whether the solve ended short of convergence.
+  bool Degraded() const { return status != MPC_status::SOLVED && status != MPC_status::ACCEPTABLE; }
+
+  MPC_status status;
+  // Ipopt iterations, or QP iterations with MPC_engine::RTI.
+  int iterations;
+  // Value of the cost at the returned trajectories, NaN for a FALLBACK of
+  // Ipopt.
+  double objective;
+  // Wall-clock time spent in Solve, in seconds.
+  double solve_time;
+  // Degraded solves so far, this one included.
+  std::size_t degraded_cycles;
+};
+
+// The result of MPC<N>::Solve: the predicted trajectory over the horizon in
+// structure-of-arrays form, one contiguous series per state and input, and
+// the solve info. The series are views into memory owned by the MPC, set up
+// once at construction and overwritten by every solve, so reading them
+// copies nothing.
+template <std::size_t N>
+struct MPC_solution : MPC_solve_info {
+  typedef Eigen::Map<const Eigen::Matrix<double, N, 1>> States;
+  typedef Eigen::Map<const Eigen::Matrix<double, N - 1, 1>> Inputs;
+
+  // `states` holds the 6 series [x, y, psi, v, cte, epsi] and `inputs` the 2
+  // series [delta, a] back to back, as in MPC_layout.
+  MPC_solution(const double *states, const double *inputs)
+      : x(states), y(states + N), psi(states + 2 * N), v(states + 3 * N),
+        cte(states + 4 * N), epsi(states + 5 * N), delta(inputs), a(inputs + N - 1) {}
+
+  States x;
+  States y;
+  States psi;
+  States v;
+  States cte;
+  States epsi;
+  Inputs delta;
+  Inputs a;
+};
+
+// The same for MPC_frenet<N>, in path coordinates.
+template <std::size_t N>
+struct Frenet_solution : MPC_solve_info {
+  typedef Eigen::Map<const Eigen::Matrix<double, N, 1>> States;
+  typedef Eigen::Map<const Eigen::Matrix<double, N - 1, 1>> Inputs;
+
+  // `states` holds the 4 series [s, ey, epsi, v] and `inputs` the 2 series
+  // [delta, a] back to back, as in Frenet_layout.
+  Frenet_solution(const double *states, const double *inputs)
+      : s(states), ey(states + N), epsi(states + 2 * N), v(states + 3 * N),
+        delta(inputs), a(inputs + N - 1) {}
+
+  States s;
+  States ey;
+  States epsi;
+  States v;
+  Inputs delta;
+  Inputs a;
+};
+
+#endif  // MPC_SOLUTION_H
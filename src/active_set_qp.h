@@ -0,0 +1,197 @@
+#ifndef ACTIVE_SET_QP_H
+#define ACTIVE_SET_QP_H
+
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include "Eigen-3.3/Eigen/Core"
+#include "Eigen-3.3/Eigen/Cholesky"
+#include "condensed_qp.h"
+#include "stage_qp.h"
+
+// Primal active-set method on the condensed QP, hot-started between control
+// cycles.
+//
+// The working set says which inputs sit at their lower or upper bound. Each
+// iteration minimizes over the free inputs with the others held fixed, then
+// either adds the first bound the step runs into or, at the minimizer, frees
+// the bound with the most negative multiplier. With box constraints every
+// working set has a feasible point, so the previous cycle's working set,
+// shifted one stage along the horizon like the plan in MPC_rti, is always a
+// valid start. When the set of active bounds does not change the solve is
+// a single reduced factorization and no working set change.
+//
+// H changes with every linearization, so the reduced factorization is
+// recomputed per working set change rather than updated; it lives in
+// storage sized at compile time.
+template <std::size_t N>
+class Active_set_qp : public Stage_qp_solver<N> {
+ public:
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+  typedef typename Condensed_qp<N>::Hessian Hessian;
+  typedef typename Condensed_qp<N>::Vector Vector;
+
+  static constexpr std::size_t nu = Condensed_qp<N>::nu;
+  static constexpr std::size_t n = Condensed_qp<N>::n;
+  static constexpr int max_size = Condensed_qp<N>::size;
+
+  typedef Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, 0, max_size, max_size> Reduced;
+  typedef Eigen::Matrix<double, Eigen::Dynamic, 1, 0, max_size, 1> ReducedVector;
+
+  // `max_changes` caps the working set changes per solve; when it is hit, or
+  // the deadline passes, the current point is returned, feasible but not
+  // optimal. `tolerance` is the
+  // size of a multiplier of the wrong sign that is still accepted.
+  Active_set_qp(int max_changes, double tolerance)
+      : max_changes(max_changes), tolerance(tolerance), hot(false),
+        u(n), gradient(n), H_free(n, n), gradient_free(n), step(n), llt(n) {
+    working_set.fill(Bound::FREE);
+  }
+
+  // Returns the number of working set changes.
+  int Solve(const Stage_qp<N> &qp, Stage_trajectory<N> &z, MPC_clock::time_point deadline) {
+    condensed.Build(qp);
+    const Hessian &H = condensed.H;
+    const Vector &g = condensed.g;
+
+    if (hot) {
+      for (std::size_t i = 0; i + nu < n; i++) {
+        working_set[i] = working_set[i + nu];
+      }
+    }
+    for (std::size_t k = 0; k + 1 < N; k++) {
+      u.template segment<nu>(U(k)) = z.u[k].cwiseMax(qp.lb).cwiseMin(qp.ub);
+    }
+    for (std::size_t i = 0; i < n; i++) {
+      if (working_set[i] == Bound::LOWER) {
+        u[i] = qp.lb[i % nu];
+      }
+      else if (working_set[i] == Bound::UPPER) {
+        u[i] = qp.ub[i % nu];
+      }
+    }
+
+    int changes = 0;
+    while (true) {
+      // Minimize over the free inputs with the others held at their bounds.
+      gradient = H * u + g;
+      std::size_t n_free = 0;
+      for (std::size_t i = 0; i < n; i++) {
+        if (working_set[i] == Bound::FREE) {
+          free_index[n_free++] = i;
+        }
+      }
+      H_free.resize(n_free, n_free);
+      gradient_free.resize(n_free);
+      for (std::size_t a = 0; a < n_free; a++) {
+        for (std::size_t b = 0; b < n_free; b++) {
+          H_free(a, b) = H(free_index[a], free_index[b]);
+        }
+        gradient_free[a] = gradient[free_index[a]];
+      }
+      llt.compute(H_free);
+      step = -llt.solve(gradient_free);
+
+      // Go as far towards the minimizer as the bounds allow.
+      double alpha = 1.0;
+      std::size_t blocking = n;
+      Bound blocking_bound = Bound::FREE;
+      for (std::size_t a = 0; a < n_free; a++) {
+        std::size_t i = free_index[a];
+        double lb = qp.lb[i % nu];
+        double ub = qp.ub[i % nu];
+        if (step[a] < 0 && u[i] + step[a] < lb) {
+          double ratio = (lb - u[i]) / step[a];
+          if (ratio < alpha) {
+            alpha = ratio;
+            blocking = i;
+            blocking_bound = Bound::LOWER;
+          }
+        }
+        else if (step[a] > 0 && u[i] + step[a] > ub) {
+          double ratio = (ub - u[i]) / step[a];
+          if (ratio < alpha) {
+            alpha = ratio;
+            blocking = i;
+            blocking_bound = Bound::UPPER;
+          }
+        }
+      }
+      for (std::size_t a = 0; a < n_free; a++) {
+        u[free_index[a]] += alpha * step[a];
+      }
+
+      if (changes == max_changes || MPC_clock::now() >= deadline) {
+        break;
+      }
+      if (blocking < n) {
+        working_set[blocking] = blocking_bound;
+        u[blocking] = blocking_bound == Bound::LOWER ? qp.lb[blocking % nu] : qp.ub[blocking % nu];
+        changes++;
+        continue;
+      }
+
+      // At the minimizer over the working set: the gradient of a fixed input
+      // is its multiplier and has to point out of the box.
+      gradient = H * u + g;
+      std::size_t release = n;
+      double worst = tolerance;
+      for (std::size_t i = 0; i < n; i++) {
+        double violation = 0.0;
+        if (working_set[i] == Bound::LOWER) {
+          violation = -gradient[i];
+        }
+        else if (working_set[i] == Bound::UPPER) {
+          violation = gradient[i];
+        }
+        if (violation > worst) {
+          worst = violation;
+          release = i;
+        }
+      }
+      if (release == n) {
+        break;
+      }
+      working_set[release] = Bound::FREE;
+      changes++;
+    }
+
+    hot = true;
+    condensed.Rollout(qp, u, z);
+    return changes;
+  }
+
+  // The next solve starts with every input free.
+  void Reset() {
+    working_set.fill(Bound::FREE);
+    hot = false;
+  }
+
+ private:
+  enum class Bound { FREE, LOWER, UPPER };
+
+  static std::size_t U(std::size_t k) { return Condensed_qp<N>::U(k); }
+
+  const int max_changes;
+  const double tolerance;
+
+  Condensed_qp<N> condensed;
+  // Working set of the previous solve, kept for the next one.
+  std::array<Bound, n> working_set;
+  bool hot;
+
+  Vector u;
+  Vector gradient;
+  std::array<std::size_t, n> free_index;
+  Reduced H_free;
+  ReducedVector gradient_free;
+  ReducedVector step;
+  Eigen::LLT<Reduced> llt;
+};
+
+template <std::size_t N> constexpr std::size_t Active_set_qp<N>::nu;
+template <std::size_t N> constexpr std::size_t Active_set_qp<N>::n;
+template <std::size_t N> constexpr int Active_set_qp<N>::max_size;
+
+#endif  // ACTIVE_SET_QP_H
@@ -0,0 +1,109 @@
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <numeric>
+#include "frame_transform.h"
+#include "helpers.h"
+#include "telemetry.h"
+
+// Times the reference main fits per message, the waypoints moved into the
+// car frame and a cubic fitted through them, with the allocating
+// polyfit(VectorXd, VectorXd, order) against the fixed-capacity polyfit<3>,
+// and the 25 points of the reference line evaluated one polyeval at a time
+// against the batched polyeval. Prints the time per call of each and the
+// largest difference between their results.
+//
+//   bench_polyfit [repetitions]
+
+typedef std::chrono::steady_clock Clock;
+
+namespace {
+
+double Seconds(Clock::duration duration) {
+	return std::chrono::duration<double>(duration).count();
+}
+
+}  // namespace
+
+int main(int argc, char *argv[]) {
+	const int repetitions = argc > 1 ? std::atoi(argv[1]) : 1000000;
+
+	// Six waypoints as the simulator sends them, around the lake track.
+	const std::array<double, 6> ptsx = {{-32.16, -43.49, -61.09, -78.29, -93.05, -107.79}};
+	const std::array<double, 6> ptsy = {{113.36, 105.94, 92.89, 78.73, 65.34, 50.57}};
+	const size_t n_waypoints = ptsx.size();
+	const int num_ref_pts = 25;
+	std::array<double, num_ref_pts> next_x;
+	std::array<double, num_ref_pts> next_y;
+	std::array<double, num_ref_pts> next_y_batched;
+	for (int i = 0; i < num_ref_pts; i++) {
+		next_x[i] = 2.0 * i;
+	}
+
+	// The car moves a little between repetitions. Results are accumulated so
+	// the work is not optimized away.
+	auto pose = [](int r) { return Pose{-40.62 + 1e-6 * r, 108.73, 3.733651}; };
+	double sum = 0.0;
+
+	Clock::time_point start = Clock::now();
+	for (int r = 0; r < repetitions; r++) {
+		VectorXd waypoints_x(n_waypoints);
+		VectorXd waypoints_y(n_waypoints);
+		MapToCar(pose(r), ptsx.data(), ptsy.data(), n_waypoints, waypoints_x.data(), waypoints_y.data());
+		sum += polyfit(waypoints_x, waypoints_y, 3)[0];
+	}
+	const double dynamic_time = Seconds(Clock::now() - start);
+
+	Eigen::Matrix<double, 4, 1> coeffs;
+	start = Clock::now();
+	for (int r = 0; r < repetitions; r++) {
+		Fit_points<Telemetry::max_waypoints> waypoints_x(n_waypoints);
+		Fit_points<Telemetry::max_waypoints> waypoints_y(n_waypoints);
+		MapToCar(pose(r), ptsx.data(), ptsy.data(), n_waypoints, waypoints_x.data(), waypoints_y.data());
+		coeffs = polyfit<3>(waypoints_x, waypoints_y);
+		sum += coeffs[0];
+	}
+	const double fixed_time = Seconds(Clock::now() - start);
+
+	start = Clock::now();
+	for (int r = 0; r < repetitions; r++) {
+		coeffs[0] += 1e-9;
+		for (int i = 0; i < num_ref_pts; i++) {
+			next_y[i] = polyeval(coeffs, next_x[i]);
+		}
+		sum += std::accumulate(next_y.begin(), next_y.end(), 0.0);
+	}
+	const double scalar_time = Seconds(Clock::now() - start);
+
+	start = Clock::now();
+	for (int r = 0; r < repetitions; r++) {
+		coeffs[0] -= 1e-9;
+		polyeval(coeffs, next_x.data(), next_y_batched.data(), num_ref_pts);
+		sum += std::accumulate(next_y_batched.begin(), next_y_batched.end(), 0.0);
+	}
+	const double batched_time = Seconds(Clock::now() - start);
+
+	// Both ways of each, once more on the same input.
+	VectorXd dynamic_x(n_waypoints);
+	VectorXd dynamic_y(n_waypoints);
+	MapToCar(pose(0), ptsx.data(), ptsy.data(), n_waypoints, dynamic_x.data(), dynamic_y.data());
+	Fit_points<Telemetry::max_waypoints> waypoints_x(dynamic_x);
+	Fit_points<Telemetry::max_waypoints> waypoints_y(dynamic_y);
+	coeffs = polyfit<3>(waypoints_x, waypoints_y);
+	const double fit_error = (polyfit(dynamic_x, dynamic_y, 3) - coeffs).cwiseAbs().maxCoeff();
+	double eval_error = 0.0;
+	polyeval(coeffs, next_x.data(), next_y_batched.data(), num_ref_pts);
+	for (int i = 0; i < num_ref_pts; i++) {
+		eval_error = std::max(eval_error, std::fabs(polyeval(coeffs, next_x[i]) - next_y_batched[i]));
+	}
+
+	std::printf("polyfit:  %.1f ns dynamic, %.1f ns fixed, largest difference %.3g\n",
+		1e9 * dynamic_time / repetitions, 1e9 * fixed_time / repetitions, fit_error);
+	std::printf("polyeval: %.1f ns scalar, %.1f ns batched, largest difference %.3g\n",
+		1e9 * scalar_time / repetitions, 1e9 * batched_time / repetitions, eval_error);
+	std::printf("(checksum %g)\n", sum);
+	return 0;
+}
@@ -0,0 +1,139 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+#include "segment_index.h"
+
+// Checks Segment_index against a linear scan over the segments, on
+// synthetic closed loops from the size of the lake track (70 points) up to
+// a million points, and times both.
+//
+// A loop is a wobbly circle with points about a meter apart. The queries
+// are seeded random points within 10 m of it, near where the car would be,
+// plus a few far off. Closest has to find a segment at the scan's smallest
+// distance, Within the same segments as the scan.
+//
+//   bench_segment_index [max_points]
+//
+// Exits with a nonzero status on the first mismatch.
+
+typedef std::chrono::steady_clock Clock;
+
+namespace {
+
+double Seconds(Clock::duration duration) {
+	return std::chrono::duration<double>(duration).count();
+}
+
+// A closed loop of `n` points, radius varying with the angle.
+void Loop(std::size_t n, std::vector<double> &x, std::vector<double> &y) {
+	const double pi = std::acos(-1.0);
+	const double radius = n / (2.0 * pi);
+	x.resize(n);
+	y.resize(n);
+	for (std::size_t i = 0; i < n; i++) {
+		const double angle = 2.0 * pi * i / n;
+		const double r = radius * (1.0 + 0.2 * std::sin(3.0 * angle) + 0.02 * std::sin(37.0 * angle));
+		x[i] = r * std::cos(angle);
+		y[i] = r * std::sin(angle);
+	}
+}
+
+Segment_index::Closest_point LinearClosest(const Segment_index &index, double x, double y) {
+	Segment_index::Closest_point best = index.OnSegment(0, x, y);
+	for (std::size_t i = 1; i < index.Segments(); i++) {
+		const Segment_index::Closest_point closest = index.OnSegment(i, x, y);
+		if (closest.distance < best.distance) {
+			best = closest;
+		}
+	}
+	return best;
+}
+
+void LinearWithin(const Segment_index &index, double x, double y, double radius,
+	std::vector<std::size_t> &segments) {
+	segments.clear();
+	for (std::size_t i = 0; i < index.Segments(); i++) {
+		if (index.OnSegment(i, x, y).distance <= radius) {
+			segments.push_back(i);
+		}
+	}
+}
+
+// Returns the number of queries on a loop of `n` points that differ from
+// the linear scan.
+int Check(std::size_t n) {
+	const int n_queries = 1000;
+	const double radius = 5.0;
+
+	std::vector<double> x, y;
+	Loop(n, x, y);
+	Segment_index index;
+	Clock::time_point start = Clock::now();
+	index.Build(x.data(), y.data(), n, true);
+	const double build_time = Seconds(Clock::now() - start);
+
+	std::mt19937_64 random(n);
+	std::uniform_int_distribution<std::size_t> point(0, n - 1);
+	std::uniform_real_distribution<double> offset(-10.0, 10.0);
+	std::vector<double> query_x(n_queries), query_y(n_queries);
+	for (int q = 0; q < n_queries; q++) {
+		const std::size_t i = point(random);
+		const double far = q % 100 == 0 ? 0.5 * n : 0.0;
+		query_x[q] = x[i] + offset(random) + far;
+		query_y[q] = y[i] + offset(random);
+	}
+
+	int failures = 0;
+	double index_time = 0.0, linear_time = 0.0;
+	double within_time = 0.0, linear_within_time = 0.0;
+	std::vector<std::size_t> within, linear_within;
+	for (int q = 0; q < n_queries; q++) {
+		start = Clock::now();
+		const Segment_index::Closest_point closest = index.Closest(query_x[q], query_y[q]);
+		Clock::time_point middle = Clock::now();
+		const Segment_index::Closest_point expected = LinearClosest(index, query_x[q], query_y[q]);
+		Clock::time_point end = Clock::now();
+		index_time += Seconds(middle - start);
+		linear_time += Seconds(end - middle);
+
+		start = Clock::now();
+		index.Within(query_x[q], query_y[q], radius, within);
+		middle = Clock::now();
+		LinearWithin(index, query_x[q], query_y[q], radius, linear_within);
+		end = Clock::now();
+		within_time += Seconds(middle - start);
+		linear_within_time += Seconds(end - middle);
+
+		// Ties may be broken either way, only the distance has to match.
+		std::sort(within.begin(), within.end());
+		const bool ok = std::fabs(closest.distance - expected.distance) <= 1e-9 * (1.0 + expected.distance) &&
+			within == linear_within;
+		if (!ok && failures++ < 3) {
+			std::printf("(%g, %g): closest %zu at %g, scan %zu at %g; %zu within, scan %zu\n",
+				query_x[q], query_y[q], closest.segment, closest.distance, expected.segment,
+				expected.distance, within.size(), linear_within.size());
+		}
+	}
+
+	std::printf("%8zu points: build %.2f ms; Closest %.2f us, scan %.2f us; "
+		"Within %.2f us, scan %.2f us; %d mismatches\n", n, 1e3 * build_time,
+		1e6 * index_time / n_queries, 1e6 * linear_time / n_queries,
+		1e6 * within_time / n_queries, 1e6 * linear_within_time / n_queries, failures);
+	return failures;
+}
+
+}  // namespace
+
+int main(int argc, char *argv[]) {
+	const std::size_t max_points = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1000000;
+
+	int failures = Check(std::min<std::size_t>(70, max_points));
+	for (std::size_t n = 1000; n <= max_points; n *= 10) {
+		failures += Check(n);
+	}
+	return failures == 0 ? 0 : 1;
+}
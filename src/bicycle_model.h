@@ -0,0 +1,78 @@
+#ifndef BICYCLE_MODEL_H
+#define BICYCLE_MODEL_H
+
+#include <cmath>
+#include "Eigen-3.3/Eigen/Core"
+#include "MPC_config.h"
+
+// The discrete kinematic bicycle model of FG_eval in plain doubles: one step
+// of the state [x, y, psi, v, cte, epsi] under the actuation [delta, a] along
+// the cubic reference `coeffs`, and its linearization. Used by the solver
+// engines that work on the linearized problem instead of the NLP.
+struct Bicycle_model {
+  typedef Eigen::Matrix<double, 6, 1> State;
+  typedef Eigen::Matrix<double, 2, 1> Input;
+  typedef Eigen::Matrix<double, 4, 1> Coeffs;
+  typedef Eigen::Matrix<double, 6, 6> StateMatrix;
+  typedef Eigen::Matrix<double, 6, 2> InputMatrix;
+
+  static State Step(const State &x, const Input &u, const Coeffs &coeffs,
+                    const MPC_config &config) {
+    const double dt = config.dt;
+    const double Lf = config.Lf;
+    double x0 = x[0], y0 = x[1], psi0 = x[2], v0 = x[3], epsi0 = x[5];
+    double delta0 = u[0], a0 = u[1];
+    double f0 = coeffs[0] + x0 * (coeffs[1] + x0 * (coeffs[2] + x0 * coeffs[3]));
+    double psides0 = std::atan(coeffs[1] + x0 * (2 * coeffs[2] + 3 * coeffs[3] * x0));
+
+    State next;
+    next << x0 + v0 * std::cos(psi0) * dt,
+            y0 + v0 * std::sin(psi0) * dt,
+            psi0 - v0 / Lf * delta0 * dt,
+            v0 + a0 * dt,
+            (f0 - y0) + v0 * std::sin(epsi0) * dt,
+            (psi0 - psides0) - v0 / Lf * delta0 * dt;
+    return next;
+  }
+
+  // First order expansion of Step around (x, u):
+  //   Step(x + dx, u + du) ~ A (x + dx) + B (u + du) + offset
+  static void Linearize(const State &x, const Input &u, const Coeffs &coeffs,
+                        const MPC_config &config, StateMatrix &A,
+                        InputMatrix &B, State &offset) {
+    const double dt = config.dt;
+    const double Lf = config.Lf;
+    double x0 = x[0], psi0 = x[2], v0 = x[3], epsi0 = x[5];
+    double delta0 = u[0];
+    double cos_psi = std::cos(psi0);
+    double sin_psi = std::sin(psi0);
+    // f' and f'' of the reference polynomial at x0
+    double df = coeffs[1] + x0 * (2 * coeffs[2] + 3 * coeffs[3] * x0);
+    double ddf = 2 * coeffs[2] + 6 * coeffs[3] * x0;
+
+    A.setIdentity();
+    A(0, 2) = -v0 * sin_psi * dt;
+    A(0, 3) = cos_psi * dt;
+    A(1, 2) = v0 * cos_psi * dt;
+    A(1, 3) = sin_psi * dt;
+    A(2, 3) = -delta0 / Lf * dt;
+    A(4, 0) = df;
+    A(4, 1) = -1.0;
+    A(4, 3) = std::sin(epsi0) * dt;
+    A(4, 4) = 0.0;
+    A(4, 5) = v0 * std::cos(epsi0) * dt;
+    A(5, 0) = -ddf / (1 + df * df);
+    A(5, 2) = 1.0;
+    A(5, 3) = -delta0 / Lf * dt;
+    A(5, 5) = 0.0;
+
+    B.setZero();
+    B(2, 0) = -v0 / Lf * dt;
+    B(3, 1) = dt;
+    B(5, 0) = -v0 / Lf * dt;
+
+    offset = Step(x, u, coeffs, config) - A * x - B * u;
+  }
+};
+
+#endif  // BICYCLE_MODEL_H
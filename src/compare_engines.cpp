@@ -0,0 +1,175 @@
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include "frame_transform.h"
+#include "helpers.h"
+#include "latency.h"
+#include "MPC.h"
+#include "telemetry.h"
+
+// Replays telemetry recorded with `mpc --record file` through the nonlinear
+// MPC solved by Ipopt and the linear time-varying MPC of the RTI engine (one
+// QP per message, on the model linearized along the previous plan) with each
+// of its QP solvers, and reports how far the latter's actuations and
+// predicted trajectories are from Ipopt's, next to the solve times and the
+// number of degraded solves, see MPC_solve_info::Degraded.
+//
+//   compare_engines recording.txt [--cold-start]
+//
+// Every controller sees every message, so each one warm starts from its own
+// previous solution as it would in main. The reference is fitted to the
+// simulator's waypoints as in main without --track.
+
+using std::string;
+
+typedef MPC<10> Controller;
+
+namespace {
+
+struct Engine {
+	string name;
+	std::unique_ptr<Controller> mpc;
+	// The last solve, owned by `mpc`.
+	const MPC_solution<10> *solution;
+
+	// Solve times in milliseconds.
+	std::vector<double> times;
+	// Differences to the reference engine, summed and largest: steering,
+	// throttle and the largest distance between the predicted trajectories.
+	double sum_error[3];
+	double max_error[3];
+};
+
+Engine *AddEngine(std::vector<std::unique_ptr<Engine>> &engines, const string &name, const MPC_config &config) {
+	engines.emplace_back(new Engine());
+	Engine *engine = engines.back().get();
+	engine->name = name;
+	engine->mpc.reset(new Controller(config));
+	engine->solution = nullptr;
+	std::fill(engine->sum_error, engine->sum_error + 3, 0.0);
+	std::fill(engine->max_error, engine->max_error + 3, 0.0);
+	return engine;
+}
+
+// What main would solve for this message, which has to have at least
+// Telemetry::min_waypoints waypoints.
+Controller::State StateAndReference(const Telemetry &telemetry, const MPC_config &config,
+	Controller::Coeffs &coeffs) {
+	size_t n_waypoints = telemetry.n_waypoints;
+	Fit_points<Telemetry::max_waypoints> waypoints_x(n_waypoints);
+	Fit_points<Telemetry::max_waypoints> waypoints_y(n_waypoints);
+	MapToCar(Pose{telemetry.x, telemetry.y, telemetry.psi}, telemetry.ptsx.data(), telemetry.ptsy.data(),
+		n_waypoints, waypoints_x.data(), waypoints_y.data());
+	coeffs = polyfit<3>(waypoints_x, waypoints_y);
+	double cte = polyeval(coeffs, 0.0);
+	double epsi = -atan(coeffs[1]);
+	return PredictState(telemetry.speed, telemetry.steering_angle, telemetry.throttle, cte, epsi, config);
+}
+
+double Percentile(std::vector<double> values, double p) {
+	if (values.empty()) {
+		return 0.0;
+	}
+	std::sort(values.begin(), values.end());
+	return values[std::min(values.size() - 1, size_t(p * values.size()))];
+}
+
+}  // namespace
+
+int main(int argc, char *argv[]) {
+	string path;
+	MPC_config config;
+	for (int i = 1; i < argc; i++) {
+		string arg = argv[i];
+		if (arg == "--cold-start") {
+			config.warm_start = false;
+		}
+		else if (path.empty() && arg.compare(0, 2, "--") != 0) {
+			path = arg;
+		}
+		else {
+			std::cerr << "Unknown argument " << arg << std::endl;
+			return -1;
+		}
+	}
+	std::ifstream in(path);
+	if (!in) {
+		std::cerr << "Usage: compare_engines recording.txt [--cold-start]" << std::endl;
+		return -1;
+	}
+
+	std::vector<std::unique_ptr<Engine>> engines;
+	config.engine = MPC_engine::IPOPT;
+	AddEngine(engines, "ipopt", config);
+	config.engine = MPC_engine::RTI;
+	for (const MPC_qp_solver_name &qp : qp_solver_names) {
+		config.qp_solver = qp.solver;
+		AddEngine(engines, string("ltv ") + qp.name, config);
+	}
+	const Engine &reference = *engines[0];
+
+	Telemetry telemetry;
+	size_t n_messages = 0;
+	string line;
+	while (std::getline(in, line)) {
+		// Too few waypoints to fit a reference to, which polyfit asserts on.
+		if (ParseTelemetry(line.data(), line.size(), Wire_format::TEXT, telemetry) != Telemetry_frame::TELEMETRY ||
+			telemetry.n_waypoints < Telemetry::min_waypoints) {
+			continue;
+		}
+		Controller::Coeffs coeffs;
+		Controller::State state = StateAndReference(telemetry, config, coeffs);
+		for (auto &engine : engines) {
+			engine->solution = &engine->mpc->Solve(state, coeffs);
+			engine->times.push_back(1000.0 * engine->solution->solve_time);
+		}
+		const MPC_solution<10> &expected = *reference.solution;
+		for (auto &engine : engines) {
+			const MPC_solution<10> &solution = *engine->solution;
+			double error[3] = {
+				std::fabs(solution.delta[0] - expected.delta[0]),
+				std::fabs(solution.a[0] - expected.a[0]),
+				0.0
+			};
+			for (int i = 0; i < solution.x.size(); i++) {
+				error[2] = std::max(error[2], std::hypot(solution.x[i] - expected.x[i], solution.y[i] - expected.y[i]));
+			}
+			for (int k = 0; k < 3; k++) {
+				engine->sum_error[k] += error[k];
+				engine->max_error[k] = std::max(engine->max_error[k], error[k]);
+			}
+		}
+		n_messages++;
+	}
+	if (n_messages == 0) {
+		std::cerr << "No telemetry in " << path << std::endl;
+		return -1;
+	}
+
+	std::cout << n_messages << " messages, differences to ipopt as mean / max" << std::endl;
+	std::cout << std::left << std::setw(16) << "engine" << std::right
+		<< std::setw(22) << "steering (rad)" << std::setw(22) << "throttle"
+		<< std::setw(22) << "trajectory (m)" << std::setw(32) << "solve ms mean / p99 / max"
+		<< std::setw(10) << "degraded" << std::endl;
+	std::cout << std::fixed;
+	for (const auto &engine : engines) {
+		std::cout << std::left << std::setw(16) << engine->name << std::right << std::setprecision(4);
+		for (int k = 0; k < 3; k++) {
+			std::cout << std::setw(11) << engine->sum_error[k] / n_messages << " /" << std::setw(9) << engine->max_error[k];
+		}
+		double sum_time = 0.0;
+		for (double time : engine->times) {
+			sum_time += time;
+		}
+		std::cout << std::setprecision(3) << std::setw(12) << sum_time / n_messages << " /"
+			<< std::setw(8) << Percentile(engine->times, 0.99) << " /"
+			<< std::setw(8) << Percentile(engine->times, 1.0)
+			<< std::setw(10) << engine->solution->degraded_cycles << std::endl;
+	}
+	return 0;
+}
@@ -0,0 +1,64 @@
+#ifndef CONDENSED_KKT_H
+#define CONDENSED_KKT_H
+
+#include <array>
+#include <cstddef>
+#include "Eigen-3.3/Eigen/Core"
+#include "Eigen-3.3/Eigen/Cholesky"
+#include "condensed_qp.h"
+#include "stage_qp.h"
+
+// Kkt policy of Qp_ipm on the condensed QP, see Condensed_qp: every Newton
+// step is one Cholesky factorization of H + sigma over the inputs only.
+//
+// The factorization costs O(N^3) flops; the structured policies win on long
+// horizons.
+template <std::size_t N>
+class Condensed_kkt {
+ public:
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+  typedef Bicycle_model::Input Input;
+  typedef std::array<Input, N - 1> Inputs;
+  typedef typename Condensed_qp<N>::Hessian Hessian;
+  typedef typename Condensed_qp<N>::Vector Vector;
+
+  static constexpr std::size_t nu = Condensed_qp<N>::nu;
+  static constexpr std::size_t n = Condensed_qp<N>::n;
+
+  Condensed_kkt() : H_sigma(n, n), llt(n), rhs(n), u(n) {}
+
+  void Setup(const Stage_qp<N> &qp) {
+    condensed.Build(qp);
+  }
+
+  void Factor(const Stage_qp<N> &qp, const Inputs &sigma) {
+    H_sigma = condensed.H;
+    for (std::size_t k = 0; k + 1 < N; k++) {
+      H_sigma.template block<nu, nu>(U(k), U(k)).diagonal() += sigma[k];
+    }
+    llt.compute(H_sigma);
+  }
+
+  void Solve(const Stage_qp<N> &qp, const Inputs &r, Stage_trajectory<N> &z) {
+    for (std::size_t k = 0; k + 1 < N; k++) {
+      rhs.template segment<nu>(U(k)) = -condensed.g.template segment<nu>(U(k)) - r[k];
+    }
+    u = llt.solve(rhs);
+    condensed.Rollout(qp, u, z);
+  }
+
+ private:
+  static std::size_t U(std::size_t k) { return Condensed_qp<N>::U(k); }
+
+  Condensed_qp<N> condensed;
+  Hessian H_sigma;
+  Eigen::LLT<Hessian> llt;
+  Vector rhs;
+  Vector u;
+};
+
+template <std::size_t N> constexpr std::size_t Condensed_kkt<N>::nu;
+template <std::size_t N> constexpr std::size_t Condensed_kkt<N>::n;
+
+#endif  // CONDENSED_KKT_H
@@ -0,0 +1,114 @@
+#ifndef CONDENSED_QP_H
+#define CONDENSED_QP_H
+
+#include <array>
+#include <cstddef>
+#include "Eigen-3.3/Eigen/Core"
+#include "stage_qp.h"
+
+// The stage QP with the states eliminated (single shooting). With x_k a
+// function of x_init and u_0 .. u_k-1 through the dynamics, it becomes a
+// dense QP over the 2 (N - 1) inputs only,
+//
+//   min 1/2 u' H u + g' u   s.t.  lb <= u <= ub.
+//
+// For short horizons H and g are sized at compile time, so the whole problem
+// stays in L1 and needs no heap allocation; past `max_fixed` inputs they are
+// allocated once on construction instead. Condensing costs O(N^2) block
+// operations.
+template <std::size_t N>
+class Condensed_qp {
+ public:
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+  typedef Bicycle_model::State State;
+  typedef Bicycle_model::InputMatrix InputMatrix;
+
+  static constexpr std::size_t nu = Stage_qp<N>::nu;
+  static constexpr std::size_t n = (N - 1) * nu;
+
+  // Larger fixed-size matrices exceed Eigen's stack allocation limit.
+  static constexpr int max_fixed = 100;
+  static constexpr int size = n <= max_fixed ? int(n) : Eigen::Dynamic;
+
+  typedef Eigen::Matrix<double, size, size> Hessian;
+  typedef Eigen::Matrix<double, size, 1> Vector;
+
+  Condensed_qp() : H(n, n), g(n) {}
+
+  Hessian H;
+  Vector g;
+
+  // Builds H and g. The sensitivities of the states to one input u_j are
+  // propagated forward, and their cost is pulled back to every u_i with the
+  // adjoint recursion, one column of blocks at a time.
+  void Build(const Stage_qp<N> &qp) {
+    // Gradient: the cost of the free response, u = 0.
+    free[0] = qp.x_init;
+    for (std::size_t k = 0; k + 1 < N; k++) {
+      free[k + 1] = qp.A[k] * free[k] + qp.c[k];
+    }
+    State adjoint = qp.Q.cwiseProduct(free[N - 1]) + qp.q;
+    g.template segment<nu>(U(N - 2)) = qp.B[N - 2].transpose() * adjoint;
+    for (std::size_t k = N - 2; k > 0; k--) {
+      adjoint = qp.Q.cwiseProduct(free[k]) + qp.q + qp.A[k].transpose() * adjoint;
+      g.template segment<nu>(U(k - 1)) = qp.B[k - 1].transpose() * adjoint;
+    }
+
+    // Hessian: for every u_j, d x_k / d u_j is zero up to k = j, B_j at
+    // k = j + 1 and A_k-1 times its predecessor after that.
+    for (std::size_t j = 0; j + 1 < N; j++) {
+      sensitivity[j + 1] = qp.B[j];
+      for (std::size_t k = j + 1; k + 1 < N; k++) {
+        sensitivity[k + 1] = qp.A[k] * sensitivity[k];
+      }
+      InputMatrix pullback = qp.Q.asDiagonal() * sensitivity[N - 1];
+      H.template block<nu, nu>(U(N - 2), U(j)) = qp.B[N - 2].transpose() * pullback;
+      for (std::size_t k = N - 2; k > 0; k--) {
+        pullback = qp.A[k].transpose() * pullback;
+        if (k > j) {
+          pullback += qp.Q.asDiagonal() * sensitivity[k];
+        }
+        H.template block<nu, nu>(U(k - 1), U(j)) = qp.B[k - 1].transpose() * pullback;
+      }
+    }
+
+    for (std::size_t k = 0; k + 1 < N; k++) {
+      for (std::size_t i = 0; i < nu; i++) {
+        H(U(k) + i, U(k) + i) += qp.R[i];
+      }
+    }
+    for (std::size_t k = 0; k + 2 < N; k++) {
+      for (std::size_t i = 0; i < nu; i++) {
+        H(U(k) + i, U(k) + i) += qp.W[i];
+        H(U(k + 1) + i, U(k + 1) + i) += qp.W[i];
+        H(U(k) + i, U(k + 1) + i) -= qp.W[i];
+        H(U(k + 1) + i, U(k) + i) -= qp.W[i];
+      }
+    }
+  }
+
+  // The trajectory of the inputs `u`: z.u = u and the states follow from the
+  // dynamics.
+  void Rollout(const Stage_qp<N> &qp, const Vector &u, Stage_trajectory<N> &z) const {
+    z.x[0] = qp.x_init;
+    for (std::size_t k = 0; k + 1 < N; k++) {
+      z.u[k] = u.template segment<nu>(U(k));
+      z.x[k + 1] = qp.A[k] * z.x[k] + qp.B[k] * z.u[k] + qp.c[k];
+    }
+  }
+
+  // Index of the first entry of u_k in u.
+  static std::size_t U(std::size_t k) { return k * nu; }
+
+ private:
+  std::array<State, N> free;
+  std::array<InputMatrix, N> sensitivity;
+};
+
+template <std::size_t N> constexpr std::size_t Condensed_qp<N>::nu;
+template <std::size_t N> constexpr std::size_t Condensed_qp<N>::n;
+template <std::size_t N> constexpr int Condensed_qp<N>::max_fixed;
+template <std::size_t N> constexpr int Condensed_qp<N>::size;
+
+#endif  // CONDENSED_QP_H
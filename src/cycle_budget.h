@@ -0,0 +1,55 @@
+#ifndef CYCLE_BUDGET_H
+#define CYCLE_BUDGET_H
+
+#include <algorithm>
+#include <chrono>
+
+// Wall-clock deadlines for the solves of the control loop. The reply to a
+// telemetry message is sent one actuation delay after the message arrived,
+// see Solve_worker, which is the one config.dt ahead that PredictState
+// starts the solver from; the simulator then answers with the next message.
+// So the whole cycle, from a message arriving to its reply being written,
+// has to fit in the delay, or the reply goes out late, the actuations take
+// effect later than the model assumes and the next message is held up.
+//
+// The latency is the part of a cycle outside the solve: waiting for the
+// solver thread, fitting the reference and writing the reply. Its recent
+// peak is kept, decaying so that one slow cycle does not shorten the solves
+// for long. A solve gets what is left of the delay, less a margin.
+class Cycle_budget {
+ public:
+  typedef std::chrono::steady_clock Clock;
+
+  // `delay` is the actuation delay in seconds, `margin` the fraction of it
+  // left unused.
+  explicit Cycle_budget(double delay, double margin = 0.1)
+      : delay_(delay), latency_(0.0), margin(margin) {}
+
+  // Deadline for the solve of a message received at `received`, in the past
+  // if the latency alone takes the whole delay.
+  Clock::time_point Deadline(Clock::time_point received) const {
+    double budget = (1.0 - margin) * delay_ - latency_;
+    return received + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(budget));
+  }
+
+  // Records the cycle of the message received at `received` as done, with
+  // `solve_time` seconds of it spent in the solver.
+  void Finish(Clock::time_point received, double solve_time) {
+    latency_ = std::max(Seconds(Clock::now() - received) - solve_time, 0.95 * latency_);
+  }
+
+  // Actuation delay and measured latency, in seconds.
+  double delay() const { return delay_; }
+  double latency() const { return latency_; }
+
+ private:
+  static double Seconds(Clock::duration duration) {
+    return std::chrono::duration<double>(duration).count();
+  }
+
+  const double delay_;
+  double latency_;
+  const double margin;
+};
+
+#endif  // CYCLE_BUDGET_H
@@ -0,0 +1,116 @@
+#ifndef DENSE_KKT_H
+#define DENSE_KKT_H
+
+#include <array>
+#include <cstddef>
+#include "Eigen-3.3/Eigen/Core"
+#include "Eigen-3.3/Eigen/LU"
+#include "stage_qp.h"
+
+// Kkt policy of Qp_ipm that assembles the full KKT matrix of the equality
+// constrained stage QP densely and factors it with partial pivoting LU.
+// Simple and structure agnostic; the cost grows with the cube of N.
+//
+// Unknowns are ordered [x_0 .. x_N-1, u_0 .. u_N-2, multipliers], the
+// equality rows are x_0 = x_init and x_k+1 - A_k x_k - B_k u_k = c_k.
+template <std::size_t N>
+class Dense_kkt {
+ public:
+  typedef Bicycle_model::Input Input;
+  typedef std::array<Input, N - 1> Inputs;
+
+  static constexpr std::size_t nx = Stage_qp<N>::nx;
+  static constexpr std::size_t nu = Stage_qp<N>::nu;
+  static constexpr std::size_t n_primal = N * nx + (N - 1) * nu;
+  static constexpr std::size_t n_dual = N * nx;
+  static constexpr std::size_t n = n_primal + n_dual;
+
+  Dense_kkt() : kkt_base(n, n), kkt(n, n), rhs(n), solution(n), lu(n) {}
+
+  // Everything but the barrier term, which only adds to the input diagonal.
+  void Setup(const Stage_qp<N> &qp) {
+    kkt_base.setZero();
+    for (std::size_t k = 0; k < N; k++) {
+      for (std::size_t i = 0; i < nx; i++) {
+        kkt_base(X(k) + i, X(k) + i) = qp.Q[i];
+      }
+    }
+    for (std::size_t k = 0; k + 1 < N; k++) {
+      for (std::size_t i = 0; i < nu; i++) {
+        kkt_base(U(k) + i, U(k) + i) = qp.R[i];
+      }
+    }
+    for (std::size_t k = 0; k + 2 < N; k++) {
+      for (std::size_t i = 0; i < nu; i++) {
+        kkt_base(U(k) + i, U(k) + i) += qp.W[i];
+        kkt_base(U(k + 1) + i, U(k + 1) + i) += qp.W[i];
+        kkt_base(U(k) + i, U(k + 1) + i) -= qp.W[i];
+        kkt_base(U(k + 1) + i, U(k) + i) -= qp.W[i];
+      }
+    }
+
+    // Equality rows and their transpose.
+    for (std::size_t i = 0; i < nx; i++) {
+      kkt_base(n_primal + i, X(0) + i) = 1.0;
+    }
+    for (std::size_t k = 0; k + 1 < N; k++) {
+      std::size_t row = n_primal + (k + 1) * nx;
+      for (std::size_t i = 0; i < nx; i++) {
+        kkt_base(row + i, X(k + 1) + i) = 1.0;
+      }
+      kkt_base.block(row, X(k), nx, nx) = -qp.A[k];
+      kkt_base.block(row, U(k), nx, nu) = -qp.B[k];
+    }
+    kkt_base.topRightCorner(n_primal, n_dual) =
+        kkt_base.bottomLeftCorner(n_dual, n_primal).transpose();
+  }
+
+  void Factor(const Stage_qp<N> &qp, const Inputs &sigma) {
+    kkt = kkt_base;
+    for (std::size_t k = 0; k + 1 < N; k++) {
+      for (std::size_t i = 0; i < nu; i++) {
+        kkt(U(k) + i, U(k) + i) += sigma[k][i];
+      }
+    }
+    lu.compute(kkt);
+  }
+
+  void Solve(const Stage_qp<N> &qp, const Inputs &r, Stage_trajectory<N> &z) {
+    for (std::size_t k = 0; k < N; k++) {
+      rhs.template segment<nx>(X(k)) = -qp.q;
+    }
+    for (std::size_t k = 0; k + 1 < N; k++) {
+      rhs.template segment<nu>(U(k)) = -r[k];
+    }
+    rhs.template segment<nx>(n_primal) = qp.x_init;
+    for (std::size_t k = 0; k + 1 < N; k++) {
+      rhs.template segment<nx>(n_primal + (k + 1) * nx) = qp.c[k];
+    }
+
+    solution = lu.solve(rhs);
+    for (std::size_t k = 0; k < N; k++) {
+      z.x[k] = solution.template segment<nx>(X(k));
+    }
+    for (std::size_t k = 0; k + 1 < N; k++) {
+      z.u[k] = solution.template segment<nu>(U(k));
+    }
+  }
+
+ private:
+  static std::size_t X(std::size_t k) { return k * nx; }
+  static std::size_t U(std::size_t k) { return N * nx + k * nu; }
+
+  Eigen::MatrixXd kkt_base;
+  Eigen::MatrixXd kkt;
+  Eigen::VectorXd rhs;
+  Eigen::VectorXd solution;
+  Eigen::PartialPivLU<Eigen::MatrixXd> lu;
+};
+
+template <std::size_t N> constexpr std::size_t Dense_kkt<N>::nx;
+template <std::size_t N> constexpr std::size_t Dense_kkt<N>::nu;
+template <std::size_t N> constexpr std::size_t Dense_kkt<N>::n_primal;
+template <std::size_t N> constexpr std::size_t Dense_kkt<N>::n_dual;
+template <std::size_t N> constexpr std::size_t Dense_kkt<N>::n;
+
+#endif  // DENSE_KKT_H
@@ -0,0 +1,95 @@
+#ifndef FRENET_EVAL_H
+#define FRENET_EVAL_H
+
+#include <cstddef>
+#include <cppad/cppad.hpp>
+#include "MPC_config.h"
+#include "MPC_layout.h"
+
+using CppAD::AD;
+
+/* The kinematic bicycle model of FG_eval in path coordinates along the
+center line of the track:
+
+s_t+1 = s_t + v_t * cos(epsi_t) / (1 - ey_t * kappa_t) * dt
+ey_t+1 = ey_t + v_t * sin(epsi_t) * dt
+epsi_t+1 = epsi_t - v_t/L_f * delta_t * dt - kappa_t * (s_t+1 - s_t)
+v_t+1 = v_t + a_t * dt
+
+s is the arc length of the closest center line point, ey the offset to the
+left of it and epsi the heading relative to the center line there. kappa_t is
+the center line curvature at s_t, looked up from the track table before the
+solve: the N - 1 curvatures are appended to the vars on the tape as known
+parameters, so there is no reference polynomial to evaluate and the horizon
+may run as far along the track as the speed takes it.
+
+The cost is the one of FG_eval, with ey and epsi in place of cte and epsi.
+*/
+template <size_t N>
+class Frenet_eval : public Frenet_layout<N> {
+public:
+	FRENET_LAYOUT_USING(N);
+
+	// One curvature per step of the horizon.
+	static constexpr size_t n_curvatures = N - 1;
+
+	const MPC_config &config;
+	Frenet_eval(const MPC_config &config) : config(config) {}
+
+	typedef CPPAD_TESTVECTOR(AD<double>) ADvector;
+	void operator()(ADvector& fg, const ADvector& vars) {
+		const double dt = config.dt;
+		const double Lf = config.Lf;
+		const double ref_v = config.ref_v;
+
+		fg[0] = 0;
+		for (unsigned int t = 0; t < N; t++) {
+			fg[0] += config.pen_cte * CppAD::pow(vars[ey_start + t], 2);
+			fg[0] += config.pen_angle * CppAD::pow(vars[epsi_start + t], 2);
+			fg[0] += config.pen_speed * CppAD::pow(vars[v_start + t] - ref_v, 2);
+		}
+		for (unsigned int t = 0; t < N - 1; t++) {
+			fg[0] += config.pen_steering * CppAD::pow(vars[delta_start + t], 2);
+			fg[0] += config.pen_throttle * CppAD::pow(vars[a_start + t], 2);
+		}
+		for (unsigned int t = 0; t < N - 2; t++) {
+			fg[0] += config.pen_st_angle * CppAD::pow(vars[delta_start + t + 1] - vars[delta_start + t], 2);
+			fg[0] += config.pen_break * CppAD::pow(vars[a_start + t + 1] - vars[a_start + t], 2);
+		}
+
+		// Initial constraints, shifted by the cost at index 0 of `fg`.
+		fg[1 + s_start] = vars[s_start];
+		fg[1 + ey_start] = vars[ey_start];
+		fg[1 + epsi_start] = vars[epsi_start];
+		fg[1 + v_start] = vars[v_start];
+
+		for (unsigned int t = 1; t < N; t++) {
+			AD<double> s1 = vars[s_start + t];
+			AD<double> ey1 = vars[ey_start + t];
+			AD<double> epsi1 = vars[epsi_start + t];
+			AD<double> v1 = vars[v_start + t];
+
+			AD<double> s0 = vars[s_start + t - 1];
+			AD<double> ey0 = vars[ey_start + t - 1];
+			AD<double> epsi0 = vars[epsi_start + t - 1];
+			AD<double> v0 = vars[v_start + t - 1];
+
+			AD<double> delta0 = vars[delta_start + t - 1];
+			AD<double> a0 = vars[a_start + t - 1];
+			AD<double> kappa0 = vars[n_vars + t - 1];
+
+			// Distance covered along the center line in this step.
+			AD<double> ds0 = v0 * CppAD::cos(epsi0) / (1 - ey0 * kappa0) * dt;
+
+			fg[1 + s_start + t] = s1 - (s0 + ds0);
+			fg[1 + ey_start + t] = ey1 - (ey0 + v0 * CppAD::sin(epsi0) * dt);
+			// the steering sign as in FG_eval
+			fg[1 + epsi_start + t] = epsi1 - (epsi0 - v0 / Lf * delta0 * dt - kappa0 * ds0);
+			fg[1 + v_start + t] = v1 - (v0 + a0 * dt);
+		}
+	}
+};
+
+template <size_t N> constexpr size_t Frenet_eval<N>::n_curvatures;
+
+#endif  // FRENET_EVAL_H
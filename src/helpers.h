@@ -1,8 +1,11 @@
 #ifndef HELPERS_H
 #define HELPERS_H
 
+#include <cassert>
+#include <cstddef>
 #include <string>
 #include "Eigen-3.3/Eigen/Core"
+#include "Eigen-3.3/Eigen/QR"
 
 using Eigen::VectorXd;
 using std::string;
@@ -10,7 +13,7 @@ using std::string;
 // Checks if the SocketIO event has JSON data.
 // If there is data the JSON object in string format will be returned,
 // else the empty string "" will be returned.
-string hasData(string s) {
+inline string hasData(string s) {
   auto found_null = s.find("null");
   auto b1 = s.find_first_of("[");
   auto b2 = s.rfind("}]");
@@ -26,19 +29,34 @@ string hasData(string s) {
 // Helper functions to fit and evaluate polynomials.
 //
 
-// Evaluate a polynomial.
-double polyeval(const VectorXd &coeffs, double x) {
+// Evaluate a polynomial, Horner's scheme. Fixed-size coefficients, as
+// returned by polyfit<Order>, are taken as they are.
+template <int Size>
+inline double polyeval(const Eigen::Matrix<double, Size, 1> &coeffs, double x) {
   double result = 0.0;
-  for (int i = 0; i < coeffs.size(); ++i) {
-    result += coeffs[i] * pow(x, i);
+  for (int i = coeffs.size() - 1; i >= 0; --i) {
+    result = result * x + coeffs[i];
   }
   return result;
 }
 
+// Evaluate a polynomial at the `n` points `x` into `y`. Horner's scheme over
+// whole arrays, which Eigen vectorizes.
+template <int Size>
+inline void polyeval(const Eigen::Matrix<double, Size, 1> &coeffs, const double *x, double *y,
+                     std::size_t n) {
+  Eigen::Map<const Eigen::ArrayXd> xs(x, n);
+  Eigen::Map<Eigen::ArrayXd> ys(y, n);
+  ys.setConstant(coeffs[coeffs.size() - 1]);
+  for (int i = coeffs.size() - 2; i >= 0; --i) {
+    ys = ys * xs + coeffs[i];
+  }
+}
+
 // Fit a polynomial.
 // Adapted from:
 // https://github.com/JuliaMath/Polynomials.jl/blob/master/src/Polynomials.jl#L676-L716
-VectorXd polyfit(const VectorXd &xvals, const VectorXd &yvals, int order) {
+inline VectorXd polyfit(const VectorXd &xvals, const VectorXd &yvals, int order) {
   assert(xvals.size() == yvals.size());
   assert(order >= 1 && order <= xvals.size() - 1);
 
@@ -60,4 +78,30 @@ VectorXd polyfit(const VectorXd &xvals, const VectorXd &yvals, int order) {
   return result;
 }
 
+// Points for the fixed-capacity polyfit: up to MaxPoints of them, stored
+// inside the object.
+template <int MaxPoints>
+using Fit_points = Eigen::Matrix<double, Eigen::Dynamic, 1, 0, MaxPoints, 1>;
+
+// Fit a polynomial of degree Order, the same least squares as above, but
+// with every matrix of a fixed maximum size, so nothing is allocated.
+template <int Order, int MaxPoints>
+inline Eigen::Matrix<double, Order + 1, 1> polyfit(const Fit_points<MaxPoints> &xvals,
+                                                   const Fit_points<MaxPoints> &yvals) {
+  assert(xvals.size() == yvals.size());
+  assert(Order >= 1 && Order <= xvals.size() - 1);
+
+  Eigen::Matrix<double, Eigen::Dynamic, Order + 1, 0, MaxPoints, Order + 1> A(xvals.size(), Order + 1);
+
+  for (int j = 0; j < xvals.size(); ++j) {
+    A(j, 0) = 1.0;
+    for (int i = 0; i < Order; ++i) {
+      A(j, i + 1) = A(j, i) * xvals(j);
+    }
+  }
+
+  Eigen::HouseholderQR<decltype(A)> Q(A);
+  return Q.solve(yvals);
+}
+
 #endif  // HELPERS_H
\ No newline at end of file
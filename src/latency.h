@@ -0,0 +1,53 @@
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include <cmath>
+#include "Eigen-3.3/Eigen/Core"
+#include "MPC_config.h"
+
+// The actuations sent back for a telemetry message only take effect after the
+// simulator latency, so the solver starts from the state the car is predicted
+// to be in by then, one model step of config.dt from the car frame origin.
+//
+// More specifically, the model is as follows:
+//   x_t+1 = x_t + v_t * cos(phi_t) * dt
+//   y_t+1 = y_t + v_t * sin(phi_t) * dt
+//   phi_t+1 = phi_t + v_t/L_f * delta_t * dt
+//   v_t+1 = v_t + a_t * d_t
+//   cte_t+1 = f(x_t) - y_t + v_t*sin(ephi_t) * dt
+//   ephi_t+1 = phi_t - phidest_t + v_t/L_f*delta_t *dt
+//
+// with x_0 = y_0 = phi_0 = 0 in the car frame, `delta` and `a` the current
+// actuations, and `cte`, `epsi` the errors against the fitted reference.
+inline Eigen::Matrix<double, 6, 1> PredictState(double v, double delta, double a,
+                                                double cte, double epsi,
+                                                const MPC_config &config) {
+  const double Lf = config.Lf;
+  const double dt = config.dt;
+  Eigen::Matrix<double, 6, 1> state;
+  state << v * dt,
+           0.0,
+           -v / Lf * delta * dt,
+           v + a * dt,
+           cte + v * std::sin(epsi) * dt,
+           epsi - v / Lf * delta * dt;
+  return state;
+}
+
+// The same for the path coordinate model of Frenet_eval, from the car's
+// [s, ey, epsi] on the track and the center line curvature `kappa` at s.
+inline Eigen::Matrix<double, 4, 1> PredictFrenetState(double s, double ey, double epsi, double v,
+                                                      double delta, double a, double kappa,
+                                                      const MPC_config &config) {
+  const double Lf = config.Lf;
+  const double dt = config.dt;
+  const double ds = v * std::cos(epsi) / (1 - ey * kappa) * dt;
+  Eigen::Matrix<double, 4, 1> state;
+  state << s + ds,
+           ey + v * std::sin(epsi) * dt,
+           epsi - v / Lf * delta * dt - kappa * ds,
+           v + a * dt;
+  return state;
+}
+
+#endif  // LATENCY_H
@@ -0,0 +1,44 @@
+#ifndef LITTLE_ENDIAN_H
+#define LITTLE_ENDIAN_H
+
+#include <cstdint>
+#include <cstring>
+
+// Fixed little-endian encoding for the binary websocket frames, independent
+// of the host's byte order; compilers turn these into plain loads and stores
+// on little-endian hosts. Doubles are IEEE 754 binary64. `p` needs no
+// alignment.
+
+inline std::uint32_t LoadU32(const char *p) {
+  std::uint32_t value = 0;
+  for (int i = 3; i >= 0; i--) {
+    value = (value << 8) | static_cast<unsigned char>(p[i]);
+  }
+  return value;
+}
+
+inline double LoadDouble(const char *p) {
+  std::uint64_t bits = 0;
+  for (int i = 7; i >= 0; i--) {
+    bits = (bits << 8) | static_cast<unsigned char>(p[i]);
+  }
+  double value;
+  std::memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+inline void StoreU32(std::uint32_t value, char *p) {
+  for (int i = 0; i < 4; i++) {
+    p[i] = static_cast<char>(value >> (8 * i));
+  }
+}
+
+inline void StoreDouble(double value, char *p) {
+  std::uint64_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  for (int i = 0; i < 8; i++) {
+    p[i] = static_cast<char>(bits >> (8 * i));
+  }
+}
+
+#endif  // LITTLE_ENDIAN_H
@@ -1,18 +1,27 @@
 #include <math.h>
 #include <uWS/uWS.h>
-#include <chrono>
+#include <algorithm>
+#include <array>
+#include <fstream>
 #include <iostream>
+#include <memory>
 #include <string>
-#include <thread>
 #include <vector>
 #include "Eigen-3.3/Eigen/Core"
 #include "Eigen-3.3/Eigen/QR"
+#include "cycle_budget.h"
+#include "frame_transform.h"
 #include "helpers.h"
-#include "json.hpp"
+#include "latency.h"
 #include "MPC.h"
+#include "MPC_frenet.h"
+#include "policy_table.h"
+#include "solve_worker.h"
+#include "steer_message.h"
+#include "telemetry.h"
+#include "track.h"
 
 // for convenience
-using nlohmann::json;
 using std::string;
 using std::vector;
 
@@ -20,159 +29,407 @@ using std::vector;
 constexpr double pi() { return M_PI; }
 double deg2rad(double x) { return x * pi() / 180; }
 double rad2deg(double x) { return x * 180 / pi(); }
-int main() {
+int main(int argc, char *argv[]) {
 	uWS::Hub h;
 
+	// `--cold-start` disables warm starting, e.g. to compare iteration counts.
+	// `--derivatives cppad|analytic|check` picks where the derivatives come
+	// from, `check` reports the largest difference between the two.
+	// `--engine ipopt|rti` picks the solver, see MPC_engine, and
+	// `--qp dense|condensed|riccati|active-set|sparse` how the RTI engine
+	// solves its QP.
+	// `--policy-table file` interpolates the actuations in a table written by
+	// make_policy_table and only solves outside of it.
+	// `--track file` takes the reference from the whole track, e.g.
+	// lake_track_waypoints.csv, instead of fitting the simulator's waypoints.
+	// `--frenet` then solves in path coordinates along it, see MPC_frenet;
+	// the policy table is not used.
+	// `--record file` appends every telemetry message to `file`, one per
+	// line, for compare_engines.
+	MPC_config config;
+	string table_path;
+	string track_path;
+	bool use_frenet = false;
+	string record_path;
+	for (int i = 1; i < argc; i++) {
+		string arg = argv[i];
+		if (arg == "--cold-start") {
+			config.warm_start = false;
+		}
+		else if (arg == "--derivatives" && i + 1 < argc) {
+			string mode = argv[++i];
+			if (mode == "cppad") {
+				config.derivatives = MPC_derivatives::CPPAD;
+			}
+			else if (mode == "analytic") {
+				config.derivatives = MPC_derivatives::ANALYTIC;
+			}
+			else if (mode == "check") {
+				config.derivatives = MPC_derivatives::CHECK;
+			}
+			else {
+				std::cerr << "Unknown --derivatives " << mode << std::endl;
+				return -1;
+			}
+		}
+		else if (arg == "--engine" && i + 1 < argc) {
+			string engine = argv[++i];
+			if (engine == "ipopt") {
+				config.engine = MPC_engine::IPOPT;
+			}
+			else if (engine == "rti") {
+				config.engine = MPC_engine::RTI;
+			}
+			else {
+				std::cerr << "Unknown --engine " << engine << std::endl;
+				return -1;
+			}
+		}
+		else if (arg == "--qp" && i + 1 < argc) {
+			string qp = argv[++i];
+			if (!ParseQpSolver(qp.c_str(), config.qp_solver)) {
+				std::cerr << "Unknown --qp " << qp << std::endl;
+				return -1;
+			}
+		}
+		else if (arg == "--policy-table" && i + 1 < argc) {
+			table_path = argv[++i];
+		}
+		else if (arg == "--track" && i + 1 < argc) {
+			track_path = argv[++i];
+		}
+		else if (arg == "--frenet") {
+			use_frenet = true;
+		}
+		else if (arg == "--record" && i + 1 < argc) {
+			record_path = argv[++i];
+		}
+		else {
+			std::cerr << "Unknown argument " << arg << std::endl;
+			return -1;
+		}
+	}
+
 	// MPC is initialized here!
-	MPC mpc;
+	MPC<10> mpc(config);
 
-	h.onMessage([&mpc](uWS::WebSocket<uWS::SERVER> ws, char *data, size_t length,
-		uWS::OpCode opCode) {
-		// "42" at the start of the message means there's a websocket message event.
-		// The 4 signifies a websocket message
-		// The 2 signifies a websocket event
-		string sdata = string(data).substr(0, length);
-		//cout << sdata << endl;
-		if (sdata.size() > 2 && sdata[0] == '4' && sdata[1] == '2') {
-			string s = hasData(sdata);
-			if (s != "") {
-				auto j = json::parse(s);
-				string event = j[0].get<string>();
-				if (event == "telemetry") {
-					// j[1] is the data JSON object
-					vector<double> ptsx = j[1]["ptsx"];
-					vector<double> ptsy = j[1]["ptsy"];
-					double px = j[1]["x"];
-					double py = j[1]["y"];
-					double psi = j[1]["psi"];
-					double v = j[1]["speed"];
-					double delta = j[1]["steering_angle"];
-					double a = j[1]["throttle"];
-					/**
-					Calculate steering angle and throttle using MPC. Both are in between [-1, 1].
-					*/
-
-					// note that MPC.solve takes the following arguments Solve(const VectorXd &state, const VectorXd &coeffs)
-					// therefore, we need to build up the state and coefficients accordingly.
-					//	Remember that the server returns waypoints using the map's coordinate system, which is different than the car's coordinate system.
-					//Transforming these waypoints will make it easier to both display them and to calculate the CTE and Epsi values for the model predictive controller.
-
-					size_t n_waypoints = ptsx.size();
-					auto waypoints_x = Eigen::VectorXd(n_waypoints);
-					auto waypoints_y = Eigen::VectorXd(n_waypoints);
-					for (int i = 0; i < n_waypoints; i++) {
-						double diff_x = ptsx[i] - px;
-						double diff_y = ptsy[i] - py;
-						waypoints_x(i) = diff_x * cos(-psi) - diff_y * sin(-psi);
-						waypoints_y(i) = diff_x * sin(-psi) + diff_y * cos(-psi);
-					}
-
-					// fit a third order polynomial to the waypoints defined in the carframe
-					auto coeffs = polyfit(waypoints_x, waypoints_y, 3);
-
-					// calculating the cte and the orientation error
-					// cte is calculated by evaluating at polynomial at x (-1) and subtracting y.
-					double cte = polyeval(coeffs, 0.0); // this is because target x and target y are both equal to 0
-														//Recall orientation error is calculated as follows e\psi = \psi - \psi{des}, where \psi{des} is can be calculated as arctan(f'(x))arctan(f(x)).
-					double epsi = -atan(coeffs[1]);  // this is because target angle psi equals to 0 and f(x) = coeff[1] + coeff[2] * x + coeff[3]*x*x with x equals to 0 in the car frame
-
-													 // the initial state of current equals to the following
-					
-					// considering taking into account simulator latency
-					/* More specifically, the model is as follows:
-					x_t+1 = x_t + v_t * cos(phi_t) * dt
-					y_t+1 = y_t + v_t * sin(phi_t) * dt
-					phi_t+1 = phi_t + v_t/L_f * delta_t * dt
-					v_t+1 = v_t + a_t * d_t
-					cte_t+1 = f(x_t) - y_t + v_t*sin(ephi_t) * dt
-					ephi_t+1 = phi_t - phidest_t + v_t/L_f*delta_t *dt
-
-					x0 is the initial state [x ,y , \psi, v, cte, e\psi],
-					coeffs are the coefficients of the fitting polynomial.
-					The bulk of this method is setting up the vehicle model constraints (constraints) and variables (vars) for Ipopt.
-					*/
-					const double Lf = 2.67;
-					const double dt = 0.1;
-					double x1 = v * dt; 
-					double y1 = 0.0; 
-					double psi1 = -v/Lf * delta * dt;
-					double v1 = v + a * dt;
-					double cte1 = cte + v * sin(epsi) * dt;
-					double epsi1 = epsi - v / Lf * delta * dt;
-
-					// Feed in the predicted state values
-					Eigen::VectorXd state(6);
-					state << x1, y1, psi1, v1, cte1, epsi1;
-
-					vector<double> info = mpc.Solve(state, coeffs);
-
-					double steer_value = info[0] / (deg2rad(25) * Lf);
-					double throttle_value = info[1];
-
-					json msgJson;
-					// NOTE: Remember to divide by deg2rad(25) before you send the 
-					//   steering value back. Otherwise the values will be in between 
-					//   [-deg2rad(25), deg2rad(25] instead of [-1, 1].
-					msgJson["steering_angle"] = steer_value;
-					msgJson["throttle"] = throttle_value;
-
-					// Display the MPC predicted trajectory 
-					vector<double> mpc_x_vals;
-					vector<double> mpc_y_vals;
-
-					/**
-					add (x,y) points to list here, points are in reference to the vehicle's coordinate system the points in the simulator are connected by a Green line
-					*/
-					// notice that the vector info contains following information:[delta, a, x[1], y[1], x[2], y[2]....]
-					for (int i = 2; i < info.size(); i += 2) {
-						mpc_x_vals.push_back(info[i]);
-						mpc_y_vals.push_back(info[i + 1]);
-					}
-
-					msgJson["mpc_x"] = mpc_x_vals;
-					msgJson["mpc_y"] = mpc_y_vals;
-
-					// Display the waypoints/reference line
-					vector<double> next_x_vals;
-					vector<double> next_y_vals;
-
-					/**
-					add (x,y) points to list here, points are in reference to the vehicle's coordinate system the points in the simulator are connected by a Yellow line
-					*/
-
-					double d_x = 2.0;
-					int num_ref_pts = 25;
-					for (unsigned int i = 0; i < num_ref_pts; i++) {
-						next_x_vals.push_back(i*d_x);
-						next_y_vals.push_back(polyeval(coeffs, i*d_x));
-					}
-
-
-					msgJson["next_x"] = next_x_vals;
-					msgJson["next_y"] = next_y_vals;
-
-
-					auto msg = "42[\"steer\"," + msgJson.dump() + "]";
-					//std::cout << msg << std::endl;
-
-					// Latency
-					// The purpose is to mimic real driving conditions where
-					// the car does actuate the commands instantly.
-					//
-					// Feel free to play around with this value but should be to drive
-					// around the track with 100ms latency.
-					//
-					// NOTE: REMEMBER TO SET THIS TO 100 MILLISECONDS BEFORE
-					// SUBMITTING.
-					std::this_thread::sleep_for(std::chrono::milliseconds(100));
-					ws.send(msg.data(), msg.length(), uWS::OpCode::TEXT);
-				}
+	Policy_table table;
+	const bool use_table = !table_path.empty();
+	if (use_table) {
+		if (!table.Load(table_path)) {
+			std::cerr << "Failed to load policy table " << table_path << std::endl;
+			return -1;
+		}
+		if (table.horizon() != MPC<10>::horizon) {
+			std::cerr << "Policy table " << table_path << " was computed with N = " << table.horizon()
+				<< ", not " << MPC<10>::horizon << std::endl;
+			return -1;
+		}
+		std::cout << "Policy table of " << table.Size() << " points, max sampled interpolation error: steering "
+			<< table.max_sampled_error[0] << ", throttle " << table.max_sampled_error[1] << std::endl;
+	}
+
+	Track track;
+	const bool use_track = !track_path.empty();
+	if (use_track) {
+		if (!track.Load(track_path)) {
+			std::cerr << "Failed to load track " << track_path << std::endl;
+			return -1;
+		}
+		std::cout << "Track of " << track.Length() << " m" << std::endl;
+	}
+	std::unique_ptr<MPC_frenet<10>> frenet;
+	if (use_frenet) {
+		if (!use_track) {
+			std::cerr << "--frenet needs a --track" << std::endl;
+			return -1;
+		}
+		frenet.reset(new MPC_frenet<10>(config));
+	}
+	// How far ahead the reference from the track reaches, about as far as
+	// the simulator's waypoints.
+	const double track_lookahead = 50.0;
+	// The car's arc length on the track, -1 until the first message.
+	double track_s = -1.0;
+	// The last reference fitted to the waypoints, kept for a message with too
+	// few of them to fit; a straight line ahead until the first fit.
+	MPC<10>::Coeffs waypoint_coeffs = MPC<10>::Coeffs::Zero();
+
+	// Messages answered from the table, reported every `report_every`.
+	int n_messages = 0;
+	int n_interpolated = 0;
+
+	// Latency
+	// The purpose is to mimic real driving conditions where
+	// the car does actuate the commands instantly.
+	//
+	// Feel free to play around with this value but should be to drive
+	// around the track with 100ms latency.
+	//
+	// NOTE: REMEMBER TO SET THIS TO 100 MILLISECONDS BEFORE
+	// SUBMITTING.
+	const int latency_ms = 100;
+
+	// Replies go out `latency_ms` after their message arrived, so every solve
+	// has to be done before then, see Cycle_budget. PredictState takes the
+	// latency to be one model step.
+	if (latency_ms != std::lround(1000 * config.dt)) {
+		std::cerr << "latency of " << latency_ms << " ms, but the model predicts " << config.dt << " s ahead" << std::endl;
+	}
+	Cycle_budget budget(latency_ms / 1000.0);
+
+	// Ipopt iteration counts and degraded solves (out of time or iterations,
+	// see MPC_solve_info::Degraded), reported every `report_every` solves.
+	const int report_every = 100;
+	int n_solves = 0;
+	int sum_iterations = 0;
+	int max_iterations = 0;
+
+	// Adds a solve to the counts; every `report_every` solves prints and
+	// resets them and returns true.
+	auto count_iterations = [&n_solves, &sum_iterations, &max_iterations, &budget, report_every](
+		const MPC_solve_info &info, const MPC_config &config) {
+		sum_iterations += info.iterations;
+		max_iterations = std::max(max_iterations, info.iterations);
+		if (++n_solves < report_every) {
+			return false;
+		}
+		std::cout << (config.warm_start ? "warm" : "cold") << " start: "
+			<< double(sum_iterations) / n_solves << " mean / "
+			<< max_iterations << " max "
+			<< (config.engine == MPC_engine::RTI ? "QP" : "Ipopt")
+			<< " iterations, " << info.degraded_cycles << " degraded solves so far; "
+			<< 1000 * budget.latency() << " of " << 1000 * budget.delay() << " ms spent outside the solver" << std::endl;
+		n_solves = 0;
+		sum_iterations = 0;
+		max_iterations = 0;
+		return true;
+	};
+
+	// Everything between a telemetry message and its reply. Runs on the solve
+	// worker's thread, which is the only one that touches `mpc` and the
+	// statistics. Writes the reply into `reply`, in the format of the
+	// telemetry.
+	auto control = [&mpc, &count_iterations, &budget, &table, use_table, &n_messages,
+		&n_interpolated, &track, use_track, track_lookahead, &track_s, &waypoint_coeffs](const Telemetry &telemetry,
+		Cycle_budget::Clock::time_point received, Wire_format format, string &reply) {
+		const MPC_clock::time_point deadline = budget.Deadline(received);
+		const double px = telemetry.x;
+		const double py = telemetry.y;
+		const double psi = telemetry.psi;
+		const double v = telemetry.speed;
+		const double delta = telemetry.steering_angle;
+		const double a = telemetry.throttle;
+		/**
+		Calculate steering angle and throttle using MPC. Both are in between [-1, 1].
+		*/
+
+		// note that MPC.solve takes the following arguments Solve(const VectorXd &state, const VectorXd &coeffs)
+		// therefore, we need to build up the state and coefficients accordingly.
+		//	Remember that the server returns waypoints using the map's coordinate system, which is different than the car's coordinate system.
+		//Transforming these waypoints will make it easier to both display them and to calculate the CTE and Epsi values for the model predictive controller.
+
+		// With a track, the reference is looked up around the car, see
+		// Track::LocalReference; the waypoints are the fallback.
+		MPC<10>::Coeffs coeffs;
+		if (!use_track || !track.LocalReference(Pose{px, py, psi}, track_lookahead, track_s, coeffs)) {
+			// ParseTelemetry drops frames with fewer waypoints than a cubic
+			// needs, but polyfit asserts on them, so never fit those.
+			size_t n_waypoints = telemetry.n_waypoints;
+			if (n_waypoints >= Telemetry::min_waypoints) {
+				Fit_points<Telemetry::max_waypoints> waypoints_x(n_waypoints);
+				Fit_points<Telemetry::max_waypoints> waypoints_y(n_waypoints);
+				MapToCar(Pose{px, py, psi}, telemetry.ptsx.data(), telemetry.ptsy.data(), n_waypoints,
+					waypoints_x.data(), waypoints_y.data());
+
+				// fit a third order polynomial to the waypoints defined in the carframe
+				waypoint_coeffs = polyfit<3>(waypoints_x, waypoints_y);
+			}
+			coeffs = waypoint_coeffs;
+		}
+
+		// calculating the cte and the orientation error
+		// cte is calculated by evaluating at polynomial at x (-1) and subtracting y.
+		double cte = polyeval(coeffs, 0.0); // this is because target x and target y are both equal to 0
+											//Recall orientation error is calculated as follows e\psi = \psi - \psi{des}, where \psi{des} is can be calculated as arctan(f'(x))arctan(f(x)).
+		double epsi = -atan(coeffs[1]);  // this is because target angle psi equals to 0 and f(x) = coeff[1] + coeff[2] * x + coeff[3]*x*x with x equals to 0 in the car frame
+
+										 // the initial state of current equals to the following
+		
+		// considering taking into account simulator latency, see PredictState
+		const double Lf = mpc.config().Lf;
+		MPC<10>::State state = PredictState(v, delta, a, cte, epsi, mpc.config());
+
+		// Inside the table's grid, interpolate instead of solving. The table
+		// only holds the first actuations, so the reply then has no predicted
+		// trajectory: mpc_x and mpc_y are empty and the simulator draws no
+		// green line. The last solution is not one step behind anymore, so
+		// the next solve starts cold.
+		const MPC_solution<10> *solution = nullptr;
+		Policy_table::Actions actions;
+		Policy_table::Key key = {{v, delta, a, coeffs[0], coeffs[1], coeffs[2], coeffs[3]}};
+		if (use_table && table.Lookup(key, actions)) {
+			n_interpolated++;
+			mpc.ResetWarmStart();
+		}
+		else {
+			solution = &mpc.Solve(state, coeffs, deadline);
+			// With nothing usable and no plan to fall back on, the actuations
+			// are whatever the solver stopped at: coast straight instead.
+			if (solution->status == MPC_status::FAILED) {
+				actions = {{0.0, 0.0}};
 			}
 			else {
-				// Manual driving
-				std::string msg = "42[\"manual\",{}]";
-				ws.send(msg.data(), msg.length(), uWS::OpCode::TEXT);
+				actions = {{solution->delta[0], solution->a[0]}};
+			}
+
+			if (count_iterations(*solution, mpc.config()) &&
+				mpc.config().derivatives == MPC_derivatives::CHECK) {
+				std::cout << "largest derivative difference to CppAD: "
+					<< mpc.DerivativeError() << std::endl;
+			}
+		}
+		if (use_table && ++n_messages == report_every) {
+			std::cout << "policy table: " << n_interpolated << " of " << n_messages
+				<< " messages interpolated" << std::endl;
+			n_messages = 0;
+			n_interpolated = 0;
+		}
+
+		double steer_value = actions[0] / (deg2rad(25) * Lf);
+		double throttle_value = actions[1];
+
+		// NOTE: Remember to divide by deg2rad(25) before you send the 
+		//   steering value back. Otherwise the values will be in between 
+		//   [-deg2rad(25), deg2rad(25] instead of [-1, 1].
+
+		// Display the MPC predicted trajectory 
+		/**
+		(x,y) points in reference to the vehicle's coordinate system, the points in the simulator are connected by a Green line
+		*/
+		// the first N - 1 states, read straight from the solution's series,
+		// none for a failed solve
+		const bool drawn = solution && solution->status != MPC_status::FAILED;
+		const double *mpc_x_vals = drawn ? solution->x.data() : nullptr;
+		const double *mpc_y_vals = drawn ? solution->y.data() : nullptr;
+		size_t n_mpc = drawn ? MPC<10>::horizon - 1 : 0;
+
+		// Display the waypoints/reference line
+		const int num_ref_pts = 25;
+		std::array<double, num_ref_pts> next_x_vals;
+		std::array<double, num_ref_pts> next_y_vals;
+
+		/**
+		add (x,y) points to list here, points are in reference to the vehicle's coordinate system the points in the simulator are connected by a Yellow line
+		*/
+
+		double d_x = 2.0;
+		for (unsigned int i = 0; i < num_ref_pts; i++) {
+			next_x_vals[i] = i*d_x;
+		}
+		polyeval(coeffs, next_x_vals.data(), next_y_vals.data(), num_ref_pts);
+
+		WriteSteer(steer_value, throttle_value, mpc_x_vals, mpc_y_vals, n_mpc,
+			next_x_vals.data(), next_y_vals.data(), num_ref_pts, format, reply);
+		budget.Finish(received, solution ? solution->solve_time : 0.0);
+	};
+
+	// The same with --frenet, in path coordinates along the track, see
+	// MPC_frenet. There is no reference to fit: the curvature of the track
+	// ahead goes into the solver instead.
+	auto control_frenet = [&frenet, &count_iterations, &budget, &track, &track_s](const Telemetry &telemetry,
+		Cycle_budget::Clock::time_point received, Wire_format format, string &reply) {
+		const MPC_clock::time_point deadline = budget.Deadline(received);
+		const Pose pose = {telemetry.x, telemetry.y, telemetry.psi};
+		const double dt = frenet->config().dt;
+		const double Lf = frenet->config().Lf;
+
+		// Where the car is relative to the closest center line point.
+		track_s = track.Project(pose.x, pose.y, track_s);
+		const Track::Point closest = track.At(track_s);
+		const double ey = (pose.y - closest.y) * cos(closest.heading) - (pose.x - closest.x) * sin(closest.heading);
+		const double epsi = remainder(pose.psi - closest.heading, 2 * pi());
+		MPC_frenet<10>::State state = PredictFrenetState(track_s, ey, epsi, telemetry.speed,
+			telemetry.steering_angle, telemetry.throttle, closest.curvature, frenet->config());
+
+		// Curvatures where the car gets to at its current speed.
+		MPC_frenet<10>::Curvatures curvatures;
+		for (int k = 0; k < curvatures.size(); k++) {
+			curvatures[k] = track.At(state[0] + k * state[3] * dt).curvature;
+		}
+
+		const Frenet_solution<10> &solution = frenet->Solve(state, curvatures, deadline);
+		count_iterations(solution, frenet->config());
+
+		// As in `control`, a failed solve coasts straight and draws nothing.
+		const bool failed = solution.status == MPC_status::FAILED;
+		const double steer_value = failed ? 0.0 : solution.delta[0] / (deg2rad(25) * Lf);
+		const double throttle_value = failed ? 0.0 : solution.a[0];
+
+		// The predicted trajectory, offset from the center line by ey, and
+		// the center line ahead, both in the car frame.
+		std::array<double, MPC_frenet<10>::horizon> map_x_vals;
+		std::array<double, MPC_frenet<10>::horizon> map_y_vals;
+		const size_t n_mpc = failed ? 0 : MPC_frenet<10>::horizon - 1;
+		for (size_t i = 0; i < n_mpc; i++) {
+			const Track::Point point = track.At(solution.s[i]);
+			map_x_vals[i] = point.x - solution.ey[i] * sin(point.heading);
+			map_y_vals[i] = point.y + solution.ey[i] * cos(point.heading);
+		}
+		std::array<double, MPC_frenet<10>::horizon> mpc_x_vals;
+		std::array<double, MPC_frenet<10>::horizon> mpc_y_vals;
+		MapToCar(pose, map_x_vals.data(), map_y_vals.data(), n_mpc, mpc_x_vals.data(), mpc_y_vals.data());
+
+		const int num_ref_pts = 25;
+		std::array<double, num_ref_pts> ref_x_vals;
+		std::array<double, num_ref_pts> ref_y_vals;
+		for (int i = 0; i < num_ref_pts; i++) {
+			const Track::Point point = track.At(track_s + 2.0 * i);
+			ref_x_vals[i] = point.x;
+			ref_y_vals[i] = point.y;
+		}
+		std::array<double, num_ref_pts> next_x_vals;
+		std::array<double, num_ref_pts> next_y_vals;
+		MapToCar(pose, ref_x_vals.data(), ref_y_vals.data(), num_ref_pts, next_x_vals.data(), next_y_vals.data());
+
+		WriteSteer(steer_value, throttle_value, mpc_x_vals.data(), mpc_y_vals.data(), n_mpc,
+			next_x_vals.data(), next_y_vals.data(), num_ref_pts, format, reply);
+		budget.Finish(received, solution.solve_time);
+	};
+
+	Solve_worker worker(h, frenet ? Solve_worker::Compute(control_frenet) : Solve_worker::Compute(control),
+		latency_ms);
+
+	std::ofstream record;
+	if (!record_path.empty()) {
+		record.open(record_path, std::ios::app);
+		if (!record) {
+			std::cerr << "Failed to open " << record_path << std::endl;
+			return -1;
+		}
+	}
+
+	// Parsed into on every message, read in place from the frame.
+	Telemetry telemetry;
+	h.onMessage([&worker, &telemetry, &record](uWS::WebSocket<uWS::SERVER> ws, char *data, size_t length,
+		uWS::OpCode opCode) {
+		// Our own simulators and replay tools can talk in BINARY frames
+		// instead, see Wire_format; the reply follows the telemetry.
+		Wire_format format = opCode == uWS::OpCode::BINARY ? Wire_format::BINARY : Wire_format::TEXT;
+		Telemetry_frame frame = ParseTelemetry(data, length, format, telemetry);
+		if (frame == Telemetry_frame::TELEMETRY) {
+			// Only the simulator's TEXT frames are recorded.
+			if (record.is_open() && format == Wire_format::TEXT) {
+				record.write(data, length) << '\n';
 			}
+			// Solved on the worker thread; the reply is sent from this loop
+			// `latency_ms` after the message arrived.
+			worker.Post(ws, telemetry, format);
+		}
+		else if (frame == Telemetry_frame::MANUAL) {
+			// Manual driving
+			std::string msg = "42[\"manual\",{}]";
+			ws.send(msg.data(), msg.length(), uWS::OpCode::TEXT);
 		}
 	});
 
@@ -191,12 +448,14 @@ int main() {
 		}
 	});
 
-	h.onConnection([&h](uWS::WebSocket<uWS::SERVER> ws, uWS::HttpRequest req) {
+	h.onConnection([&h, &worker](uWS::WebSocket<uWS::SERVER> ws, uWS::HttpRequest req) {
+		worker.Opened(ws);
 		std::cout << "Connected!!!" << std::endl;
 	});
 
-	h.onDisconnection([&h](uWS::WebSocket<uWS::SERVER> ws, int code,
+	h.onDisconnection([&h, &worker](uWS::WebSocket<uWS::SERVER> ws, int code,
 		char *message, size_t length) {
+		worker.Closed(ws);
 		ws.close();
 		std::cout << "Disconnected" << std::endl;
 	});
@@ -0,0 +1,161 @@
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include "latency.h"
+#include "MPC.h"
+#include "policy_table.h"
+
+// Builds the policy table for explicit MPC: solves MPC<10> with the default
+// MPC_config on every grid point, spread over all cores, then measures the
+// interpolation error on random cell centers.
+//
+//   make_policy_table [--out policy_table.bin] [--threads T] [--validate M]
+//                     [--dim name min max count]...
+//
+// `--dim` changes one axis, `name` is one of Policy_table::dim_names. The
+// solves run on T threads at once, which needs a reentrant linear solver in
+// Ipopt (see MPC_parallel_setup); use `--threads 1` otherwise.
+
+using std::string;
+
+typedef MPC<10> Controller;
+
+// What main would solve for this key.
+static Policy_table::Actions SolveKey(Controller &mpc, const Policy_table::Key &key) {
+	double v = key[0], delta = key[1], a = key[2];
+	Controller::Coeffs coeffs;
+	coeffs << key[3], key[4], key[5], key[6];
+	double cte = coeffs[0];
+	double epsi = -atan(coeffs[1]);
+	const MPC_solution<10> &solution = mpc.Solve(PredictState(v, delta, a, cte, epsi, mpc.config()), coeffs);
+	return Policy_table::Actions{{solution.delta[0], solution.a[0]}};
+}
+
+// Runs `work(mpc, i)` for i in [0, count) on `n_threads` threads, each with
+// its own controller. Thread t is CppAD thread t + 1, see MPC_parallel_setup.
+template <typename Work>
+static void ParallelFor(size_t count, size_t n_threads, const MPC_config &config, Work work) {
+	std::atomic<size_t> next(0);
+	std::vector<std::thread> threads;
+	for (size_t t = 0; t < n_threads; t++) {
+		threads.emplace_back([&, t]() {
+			MPC_thread thread(t + 1);
+			Controller mpc(config);
+			for (size_t i = next++; i < count; i = next++) {
+				work(mpc, i);
+				if (t == 0 && i % 10000 == 0) {
+					std::cout << "  " << i << " / " << count << std::endl;
+				}
+			}
+		});
+	}
+	for (std::thread &thread : threads) {
+		thread.join();
+	}
+}
+
+int main(int argc, char *argv[]) {
+	// Speed in the simulator's units, steering in radians, throttle in
+	// [-1, 1], and a reference that stays within a few meters of the car.
+	Policy_table::Axes axes = {{
+		{0.0, 110.0, 8},
+		{-0.436332, 0.436332, 5},
+		{-1.0, 1.0, 3},
+		{-4.0, 4.0, 9},
+		{-0.6, 0.6, 7},
+		{-0.02, 0.02, 5},
+		{-2e-4, 2e-4, 3}
+	}};
+	string out = "policy_table.bin";
+	size_t n_threads = std::max(1u, std::thread::hardware_concurrency());
+	size_t n_validate = 1000;
+
+	for (int i = 1; i < argc; i++) {
+		string arg = argv[i];
+		if (arg == "--out" && i + 1 < argc) {
+			out = argv[++i];
+		}
+		else if (arg == "--threads" && i + 1 < argc) {
+			n_threads = std::max(1, atoi(argv[++i]));
+		}
+		else if (arg == "--validate" && i + 1 < argc) {
+			n_validate = std::max(0, atoi(argv[++i]));
+		}
+		else if (arg == "--dim" && i + 4 < argc) {
+			string name = argv[++i];
+			size_t d = std::find(Policy_table::dim_names, Policy_table::dim_names + Policy_table::n_dims, name) -
+				Policy_table::dim_names;
+			double min = atof(argv[++i]);
+			double max = atof(argv[++i]);
+			int count = atoi(argv[++i]);
+			if (d == Policy_table::n_dims || count < 2 || !(max > min)) {
+				std::cerr << "Invalid --dim " << name << std::endl;
+				return -1;
+			}
+			axes[d] = Policy_table::Axis{min, max, std::uint32_t(count)};
+		}
+		else {
+			std::cerr << "Unknown argument " << arg << std::endl;
+			return -1;
+		}
+	}
+
+	MPC_config config;
+	// Every point on its own, so the table does not depend on the order the
+	// threads visit the grid in.
+	config.warm_start = false;
+	// The workers and this thread, which only waits for them.
+	MPC_parallel_setup(n_threads + 1);
+
+	Policy_table table(axes, Controller::horizon);
+	std::cout << "Solving " << table.Size() << " grid points on " << n_threads << " threads" << std::endl;
+	ParallelFor(table.Size(), n_threads, config, [&table](Controller &mpc, size_t i) {
+		table.Set(i, SolveKey(mpc, table.Point(i)));
+	});
+
+	// Cell centers of random cells.
+	std::vector<Policy_table::Key> centers(n_validate);
+	std::mt19937 random(1);
+	for (Policy_table::Key &key : centers) {
+		for (size_t d = 0; d < Policy_table::n_dims; d++) {
+			const Policy_table::Axis &axis = axes[d];
+			double step = (axis.max - axis.min) / (axis.count - 1);
+			key[d] = axis.min + step * (random() % (axis.count - 1) + 0.5);
+		}
+	}
+	std::vector<Policy_table::Actions> errors(n_validate);
+	std::cout << "Validating on " << n_validate << " cell centers" << std::endl;
+	ParallelFor(n_validate, n_threads, config, [&](Controller &mpc, size_t i) {
+		Policy_table::Actions solved = SolveKey(mpc, centers[i]);
+		Policy_table::Actions interpolated;
+		table.Lookup(centers[i], interpolated);
+		for (size_t o = 0; o < Policy_table::n_outputs; o++) {
+			errors[i][o] = std::fabs(solved[o] - interpolated[o]);
+		}
+	});
+	for (size_t o = 0; o < Policy_table::n_outputs; o++) {
+		std::vector<double> error(n_validate);
+		for (size_t i = 0; i < n_validate; i++) {
+			error[i] = errors[i][o];
+		}
+		std::sort(error.begin(), error.end());
+		table.max_sampled_error[o] = n_validate ? error.back() : 0.0;
+		std::cout << (o == 0 ? "steering" : "throttle") << " interpolation error: max sampled "
+			<< table.max_sampled_error[o] << ", median " << (n_validate ? error[n_validate / 2] : 0.0) << std::endl;
+	}
+
+	// Read back, as main will.
+	Policy_table written;
+	if (!table.Save(out) || !written.Load(out) || written.Size() != table.Size()) {
+		std::cerr << "Failed to write " << out << std::endl;
+		return -1;
+	}
+	std::cout << "Wrote " << out << std::endl;
+	return 0;
+}
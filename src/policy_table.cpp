@@ -0,0 +1,164 @@
+#include "policy_table.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+namespace {
+
+const char magic[8] = {'M', 'P', 'C', 'P', 'T', 'B', 'L', '1'};
+
+template <typename T>
+void Write(std::ofstream &out, const T &value) {
+	out.write(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+template <typename T>
+void Read(std::ifstream &in, T &value) {
+	in.read(reinterpret_cast<char *>(&value), sizeof(value));
+}
+
+}  // namespace
+
+constexpr std::size_t Policy_table::n_dims;
+constexpr std::size_t Policy_table::n_outputs;
+
+const char *const Policy_table::dim_names[n_dims] = {"v", "delta", "a", "c0", "c1", "c2", "c3"};
+
+Policy_table::Policy_table() : horizon_(0) {
+	max_sampled_error.fill(0.0);
+	for (std::size_t d = 0; d < n_dims; d++) {
+		axes_[d] = Axis{0.0, 1.0, 2};
+	}
+	Init();
+}
+
+Policy_table::Policy_table(const Axes &axes, std::size_t horizon) : axes_(axes), horizon_(horizon) {
+	max_sampled_error.fill(0.0);
+	Init();
+}
+
+void Policy_table::Init() {
+	std::size_t size = 1;
+	for (std::size_t d = n_dims; d-- > 0;) {
+		strides[d] = size;
+		steps[d] = (axes_[d].max - axes_[d].min) / (axes_[d].count - 1);
+		size *= axes_[d].count;
+	}
+	for (std::size_t corner = 0; corner < corner_offsets.size(); corner++) {
+		corner_offsets[corner] = 0;
+		for (std::size_t d = 0; d < n_dims; d++) {
+			if (corner & (std::size_t(1) << d)) {
+				corner_offsets[corner] += strides[d];
+			}
+		}
+	}
+	values.assign(size * n_outputs, 0.0f);
+}
+
+Policy_table::Key Policy_table::Point(std::size_t index) const {
+	Key key;
+	for (std::size_t d = 0; d < n_dims; d++) {
+		key[d] = axes_[d].min + steps[d] * (index / strides[d]);
+		index %= strides[d];
+	}
+	return key;
+}
+
+void Policy_table::Set(std::size_t index, const Actions &actions) {
+	for (std::size_t o = 0; o < n_outputs; o++) {
+		values[index * n_outputs + o] = float(actions[o]);
+	}
+}
+
+bool Policy_table::Lookup(const Key &key, Actions &actions) const {
+	std::size_t base = 0;
+	double fraction[n_dims];
+	for (std::size_t d = 0; d < n_dims; d++) {
+		const Axis &axis = axes_[d];
+		// also rejects NaN
+		if (!(key[d] >= axis.min && key[d] <= axis.max)) {
+			return false;
+		}
+		double position = (key[d] - axis.min) / steps[d];
+		std::size_t cell = std::min(std::size_t(position), std::size_t(axis.count - 2));
+		fraction[d] = position - cell;
+		base += cell * strides[d];
+	}
+
+	// Gather the corners of the cell, then interpolate along the last axis
+	// first, halving the corners every time.
+	double corners[1 << n_dims][n_outputs];
+	for (std::size_t corner = 0; corner < corner_offsets.size(); corner++) {
+		const float *value = &values[(base + corner_offsets[corner]) * n_outputs];
+		for (std::size_t o = 0; o < n_outputs; o++) {
+			corners[corner][o] = value[o];
+		}
+	}
+	for (std::size_t d = n_dims; d-- > 0;) {
+		std::size_t half = std::size_t(1) << d;
+		for (std::size_t corner = 0; corner < half; corner++) {
+			for (std::size_t o = 0; o < n_outputs; o++) {
+				corners[corner][o] += fraction[d] * (corners[corner + half][o] - corners[corner][o]);
+			}
+		}
+	}
+	for (std::size_t o = 0; o < n_outputs; o++) {
+		actions[o] = corners[0][o];
+	}
+	return true;
+}
+
+bool Policy_table::Save(const std::string &path) const {
+	std::ofstream out(path, std::ios::binary);
+	if (!out) {
+		return false;
+	}
+	out.write(magic, sizeof(magic));
+	Write(out, std::uint32_t(n_dims));
+	Write(out, std::uint32_t(n_outputs));
+	Write(out, std::uint32_t(horizon_));
+	for (const Axis &axis : axes_) {
+		Write(out, axis.min);
+		Write(out, axis.max);
+		Write(out, axis.count);
+	}
+	for (double error : max_sampled_error) {
+		Write(out, error);
+	}
+	out.write(reinterpret_cast<const char *>(values.data()), values.size() * sizeof(float));
+	return bool(out);
+}
+
+bool Policy_table::Load(const std::string &path) {
+	std::ifstream in(path, std::ios::binary);
+	char file_magic[sizeof(magic)];
+	in.read(file_magic, sizeof(file_magic));
+	std::uint32_t dims = 0, outputs = 0, horizon = 0;
+	Read(in, dims);
+	Read(in, outputs);
+	Read(in, horizon);
+	if (!in || std::memcmp(file_magic, magic, sizeof(magic)) != 0 ||
+		dims != n_dims || outputs != n_outputs) {
+		return false;
+	}
+	Axes axes;
+	for (Axis &axis : axes) {
+		Read(in, axis.min);
+		Read(in, axis.max);
+		Read(in, axis.count);
+		if (!in || axis.count < 2 || !(axis.max > axis.min)) {
+			return false;
+		}
+	}
+	Actions error;
+	for (double &e : error) {
+		Read(in, e);
+	}
+
+	axes_ = axes;
+	horizon_ = horizon;
+	Init();
+	max_sampled_error = error;
+	in.read(reinterpret_cast<char *>(values.data()), values.size() * sizeof(float));
+	return bool(in);
+}
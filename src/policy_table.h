@@ -0,0 +1,85 @@
+#ifndef POLICY_TABLE_H
+#define POLICY_TABLE_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Explicit MPC: the first actuations of MPC::Solve precomputed on a regular
+// grid and interpolated multilinearly at run time.
+//
+// The grid is over the values main derives from a telemetry message before
+// it solves: the speed, the current steering angle and throttle, and the
+// coefficients of the reference polynomial in the car frame. The solver state
+// follows from them through PredictState, so the table covers the whole
+// input of the controller.
+//
+// The table is written and read as a compact binary file: a header with the
+// axes and the largest sampled error, then the actuations as 32-bit floats,
+// the last axis varying fastest. make_policy_table builds it.
+class Policy_table {
+ public:
+  // [v, delta, a, c0, c1, c2, c3]
+  static constexpr std::size_t n_dims = 7;
+  // [delta, a], as returned by MPC::Solve
+  static constexpr std::size_t n_outputs = 2;
+
+  typedef std::array<double, n_dims> Key;
+  typedef std::array<double, n_outputs> Actions;
+
+  // `count` evenly spaced grid values from `min` to `max`, count >= 2.
+  struct Axis {
+    double min;
+    double max;
+    std::uint32_t count;
+  };
+  typedef std::array<Axis, n_dims> Axes;
+
+  static const char *const dim_names[n_dims];
+
+  Policy_table();
+  Policy_table(const Axes &axes, std::size_t horizon);
+
+  // Number of grid points.
+  std::size_t Size() const { return values.size() / n_outputs; }
+  // Key of grid point `index`, 0 <= index < Size().
+  Key Point(std::size_t index) const;
+  void Set(std::size_t index, const Actions &actions);
+
+  // Interpolates the actuations at `key`. Returns false if it lies outside
+  // the grid, the caller has to solve online then.
+  bool Lookup(const Key &key, Actions &actions) const;
+
+  // Return false when the file cannot be written, or cannot be read as a
+  // table with the layout above.
+  bool Save(const std::string &path) const;
+  bool Load(const std::string &path);
+
+  const Axes &axes() const { return axes_; }
+  // Horizon of the MPC the table was computed with.
+  std::size_t horizon() const { return horizon_; }
+
+  // Largest difference to the online solution seen on validation points,
+  // per output. make_policy_table samples random cell centers, where
+  // multilinear interpolation is furthest from the grid values; it is not a
+  // bound, other points can be off by more.
+  Actions max_sampled_error;
+
+ private:
+  void Init();
+
+  Axes axes_;
+  std::size_t horizon_;
+  // Grid point index step along every axis.
+  std::array<std::size_t, n_dims> strides;
+  // Grid spacing along every axis.
+  std::array<double, n_dims> steps;
+  // Offsets of the 2^n_dims corners of a cell from its first corner; bit d
+  // of the corner number selects the upper side along axis d.
+  std::array<std::size_t, 1 << n_dims> corner_offsets;
+  std::vector<float> values;
+};
+
+#endif  // POLICY_TABLE_H
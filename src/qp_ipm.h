@@ -0,0 +1,162 @@
+#ifndef QP_IPM_H
+#define QP_IPM_H
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include "Eigen-3.3/Eigen/Core"
+#include "stage_qp.h"
+
+// Mehrotra predictor-corrector interior point method for Stage_qp.
+//
+// Only the inputs have inequalities, so with slacks s_l = u - lb, s_u = ub - u
+// and their multipliers y_l, y_u, every Newton step is the equality
+// constrained stage QP with the input Hessian increased by
+//   sigma = y_l / s_l + y_u / s_u
+// and a modified input gradient. The Kkt policy solves that system:
+//
+//   void Setup(const Stage_qp<N> &qp);
+//   void Factor(const Stage_qp<N> &qp, const Inputs &sigma);
+//   void Solve(const Stage_qp<N> &qp, const Inputs &r, Stage_trajectory<N> &z);
+//
+// Setup is called once per QP, Factor once per iteration and Solve twice.
+// Solve returns in `z` the minimizer of the stage QP with the input Hessian
+// R + sigma_k and the input gradient r_k, subject to the dynamics only. The
+// policy decides how the structure is exploited.
+template <std::size_t N, class Kkt>
+class Qp_ipm : public Stage_qp_solver<N> {
+ public:
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+  typedef Bicycle_model::Input Input;
+  typedef std::array<Input, N - 1> Inputs;
+
+  Qp_ipm(int max_iterations, double tolerance)
+      : max_iterations(max_iterations), tolerance(tolerance) {}
+
+  int Solve(const Stage_qp<N> &qp, Stage_trajectory<N> &z, MPC_clock::time_point deadline) {
+    const double tau = 0.995;
+    const double m = 2.0 * (N - 1) * Stage_qp<N>::nu;
+
+    // Start strictly inside the bounds, centered with mu = 1. States need no
+    // care: the first full step makes them satisfy the dynamics.
+    for (std::size_t k = 0; k + 1 < N; k++) {
+      Input margin = 0.01 * (qp.ub - qp.lb);
+      z.u[k] = z.u[k].cwiseMax(qp.lb + margin).cwiseMin(qp.ub - margin);
+      s_l[k] = z.u[k] - qp.lb;
+      s_u[k] = qp.ub - z.u[k];
+      y_l[k] = s_l[k].cwiseInverse();
+      y_u[k] = s_u[k].cwiseInverse();
+    }
+    kkt.Setup(qp);
+    // Fraction of the initial dynamics residual that is left.
+    double infeasibility = 1.0;
+
+    int iteration = 0;
+    for (; iteration < max_iterations; iteration++) {
+      double mu = Complementarity(s_l, y_l, s_u, y_u) / m;
+      if (mu < tolerance && infeasibility < tolerance) {
+        break;
+      }
+      // Stopped early the states only satisfy the dynamics after a full step.
+      if (MPC_clock::now() >= deadline) {
+        break;
+      }
+
+      for (std::size_t k = 0; k + 1 < N; k++) {
+        sigma[k] = y_l[k].cwiseQuotient(s_l[k]) + y_u[k].cwiseQuotient(s_u[k]);
+      }
+      kkt.Factor(qp, sigma);
+
+      // Predictor: pure Newton step towards complementarity 0.
+      for (std::size_t k = 0; k + 1 < N; k++) {
+        r[k] = -sigma[k].cwiseProduct(z.u[k]);
+      }
+      kkt.Solve(qp, r, z_new);
+      for (std::size_t k = 0; k + 1 < N; k++) {
+        Input du = z_new.u[k] - z.u[k];
+        ds_l[k] = du;
+        ds_u[k] = -du;
+        dy_l[k] = -y_l[k] - y_l[k].cwiseQuotient(s_l[k]).cwiseProduct(du);
+        dy_u[k] = -y_u[k] + y_u[k].cwiseQuotient(s_u[k]).cwiseProduct(du);
+      }
+      double alpha_aff = std::min(StepToBoundary(s_l, ds_l, 1.0), StepToBoundary(s_u, ds_u, 1.0));
+      alpha_aff = std::min(alpha_aff, std::min(StepToBoundary(y_l, dy_l, 1.0), StepToBoundary(y_u, dy_u, 1.0)));
+      double mu_aff = 0.0;
+      for (std::size_t k = 0; k + 1 < N; k++) {
+        mu_aff += (s_l[k] + alpha_aff * ds_l[k]).dot(y_l[k] + alpha_aff * dy_l[k]);
+        mu_aff += (s_u[k] + alpha_aff * ds_u[k]).dot(y_u[k] + alpha_aff * dy_u[k]);
+      }
+      mu_aff /= m;
+      double centering = std::min(1.0, std::pow(mu_aff / mu, 3));
+
+      // Corrector: aim at centering * mu, including the second order term of
+      // the predictor.
+      for (std::size_t k = 0; k + 1 < N; k++) {
+        t_l[k] = Input::Constant(centering * mu) - ds_l[k].cwiseProduct(dy_l[k]);
+        t_u[k] = Input::Constant(centering * mu) - ds_u[k].cwiseProduct(dy_u[k]);
+        r[k] = -sigma[k].cwiseProduct(z.u[k]) - t_l[k].cwiseQuotient(s_l[k]) + t_u[k].cwiseQuotient(s_u[k]);
+      }
+      kkt.Solve(qp, r, z_new);
+      for (std::size_t k = 0; k + 1 < N; k++) {
+        Input du = z_new.u[k] - z.u[k];
+        ds_l[k] = du;
+        ds_u[k] = -du;
+        dy_l[k] = t_l[k].cwiseQuotient(s_l[k]) - y_l[k] - y_l[k].cwiseQuotient(s_l[k]).cwiseProduct(du);
+        dy_u[k] = t_u[k].cwiseQuotient(s_u[k]) - y_u[k] + y_u[k].cwiseQuotient(s_u[k]).cwiseProduct(du);
+      }
+      double alpha = std::min(StepToBoundary(s_l, ds_l, tau), StepToBoundary(s_u, ds_u, tau));
+      alpha = std::min(alpha, std::min(StepToBoundary(y_l, dy_l, tau), StepToBoundary(y_u, dy_u, tau)));
+
+      for (std::size_t k = 0; k < N; k++) {
+        z.x[k] += alpha * (z_new.x[k] - z.x[k]);
+      }
+      for (std::size_t k = 0; k + 1 < N; k++) {
+        z.u[k] += alpha * ds_l[k];
+        s_l[k] += alpha * ds_l[k];
+        s_u[k] += alpha * ds_u[k];
+        y_l[k] += alpha * dy_l[k];
+        y_u[k] += alpha * dy_u[k];
+      }
+      infeasibility *= 1.0 - alpha;
+    }
+    return iteration;
+  }
+
+  Kkt kkt;
+
+ private:
+  static double Complementarity(const Inputs &s_l, const Inputs &y_l,
+                                const Inputs &s_u, const Inputs &y_u) {
+    double sum = 0.0;
+    for (std::size_t k = 0; k + 1 < N; k++) {
+      sum += s_l[k].dot(y_l[k]) + s_u[k].dot(y_u[k]);
+    }
+    return sum;
+  }
+
+  // Largest step in (0, 1] that keeps v + step * dv >= (1 - tau) * v.
+  static double StepToBoundary(const Inputs &v, const Inputs &dv, double tau) {
+    double step = 1.0;
+    for (std::size_t k = 0; k + 1 < N; k++) {
+      for (std::size_t i = 0; i < Stage_qp<N>::nu; i++) {
+        if (dv[k][i] < 0) {
+          step = std::min(step, -tau * v[k][i] / dv[k][i]);
+        }
+      }
+    }
+    return step;
+  }
+
+  const int max_iterations;
+  const double tolerance;
+
+  Stage_trajectory<N> z_new;
+  Inputs s_l, s_u, y_l, y_u;
+  Inputs ds_l, ds_u, dy_l, dy_u;
+  Inputs t_l, t_u;
+  Inputs sigma, r;
+};
+
+#endif  // QP_IPM_H
@@ -0,0 +1,122 @@
+#ifndef RICCATI_KKT_H
+#define RICCATI_KKT_H
+
+#include <array>
+#include <cstddef>
+#include "Eigen-3.3/Eigen/Core"
+#include "Eigen-3.3/Eigen/Cholesky"
+#include "stage_qp.h"
+
+// Kkt policy of Qp_ipm that solves the stage QP with a Riccati recursion:
+// one backward and one forward sweep over fixed-size blocks, so the cost is
+// linear in N. This is the policy for long horizons.
+//
+// The rate cost 1/2 (u_k - u_k-1)' W (u_k - u_k-1) couples neighbouring
+// inputs, so the recursion runs on the augmented state e_k = [x_k; u_k-1]
+// with the dynamics
+//
+//   e_k+1 = [A_k 0; 0 0] e_k + [B_k; I] u_k + [c_k; 0]
+//
+// and, for k >= 1, the stage cost 1/2 e_k' diag(Q, W) e_k + 1/2 u_k' W u_k
+// - u_k' [0 W] e_k on top of the cost in Stage_qp. u_-1 does not exist; e_0
+// carries a zero there and stage 0 has no rate cost.
+template <std::size_t N>
+class Riccati_kkt {
+ public:
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+  typedef Bicycle_model::Input Input;
+  typedef std::array<Input, N - 1> Inputs;
+
+  static constexpr std::size_t nx = Stage_qp<N>::nx;
+  static constexpr std::size_t nu = Stage_qp<N>::nu;
+  static constexpr std::size_t ne = nx + nu;
+
+  typedef Eigen::Matrix<double, ne, 1> Augmented;
+  typedef Eigen::Matrix<double, ne, ne> AugmentedMatrix;
+  typedef Eigen::Matrix<double, nu, ne> Gain;
+  typedef Eigen::Matrix<double, nu, nu> InputHessian;
+
+  void Setup(const Stage_qp<N> &qp) {
+    Q_rate.setZero();
+    Q_rate.template topLeftCorner<nx, nx>().diagonal() = qp.Q;
+    Q_rate.template bottomRightCorner<nu, nu>().diagonal() = qp.W;
+    Q_terminal.setZero();
+    Q_terminal.template topLeftCorner<nx, nx>().diagonal() = qp.Q;
+    q.setZero();
+    q.template head<nx>() = qp.q;
+    S_rate.setZero();
+    S_rate.template rightCols<nu>().diagonal() = -qp.W;
+  }
+
+  // Backward sweep over the matrices: the cost-to-go Hessians P_k, the
+  // factored input Hessians and the feedback gains. The augmented dynamics
+  // are never formed, their zero and identity blocks are applied in place.
+  void Factor(const Stage_qp<N> &qp, const Inputs &sigma) {
+    P[N - 1] = Q_terminal;
+    for (std::size_t k = N - 1; k-- > 0;) {
+      const AugmentedMatrix &P_next = P[k + 1];
+      PB = P_next.template leftCols<nx>() * qp.B[k] + P_next.template rightCols<nu>();
+      InputHessian H_uu = qp.B[k].transpose() * PB.template topRows<nx>() + PB.template bottomRows<nu>();
+      H_uu.diagonal() += qp.R + sigma[k];
+      H_ux[k].template leftCols<nx>() = PB.template topRows<nx>().transpose() * qp.A[k];
+      H_ux[k].template rightCols<nu>().setZero();
+      if (k > 0) {
+        H_uu.diagonal() += qp.W;
+        H_ux[k] += S_rate;
+      }
+      llt[k].compute(H_uu);
+      K[k] = -llt[k].solve(H_ux[k]);
+
+      P[k] = k > 0 ? Q_rate : Q_terminal;
+      P[k].template topLeftCorner<nx, nx>() +=
+          qp.A[k].transpose() * P_next.template topLeftCorner<nx, nx>() * qp.A[k];
+      P[k] += H_ux[k].transpose() * K[k];
+    }
+  }
+
+  // Backward sweep over the vectors, then the forward rollout.
+  void Solve(const Stage_qp<N> &qp, const Inputs &r, Stage_trajectory<N> &z) {
+    s = q;
+    for (std::size_t k = N - 1; k-- > 0;) {
+      // Gradient of the cost-to-go at the offset of the dynamics.
+      Augmented next = P[k + 1].template leftCols<nx>() * qp.c[k] + s;
+      feedforward[k] = -llt[k].solve(r[k] + qp.B[k].transpose() * next.template head<nx>() +
+                                     next.template tail<nu>());
+      s = q + H_ux[k].transpose() * feedforward[k];
+      s.template head<nx>() += qp.A[k].transpose() * next.template head<nx>();
+    }
+
+    e.template head<nx>() = qp.x_init;
+    e.template tail<nu>().setZero();
+    z.x[0] = qp.x_init;
+    for (std::size_t k = 0; k + 1 < N; k++) {
+      z.u[k] = K[k] * e + feedforward[k];
+      z.x[k + 1] = qp.A[k] * z.x[k] + qp.B[k] * z.u[k] + qp.c[k];
+      e.template head<nx>() = z.x[k + 1];
+      e.template tail<nu>() = z.u[k];
+    }
+  }
+
+ private:
+  AugmentedMatrix Q_rate;
+  AugmentedMatrix Q_terminal;
+  Augmented q;
+  Gain S_rate;
+
+  std::array<AugmentedMatrix, N> P;
+  std::array<Gain, N - 1> H_ux;
+  std::array<Gain, N - 1> K;
+  std::array<Eigen::LLT<InputHessian>, N - 1> llt;
+  Eigen::Matrix<double, ne, nu> PB;
+
+  std::array<Input, N - 1> feedforward;
+  Augmented s;
+  Augmented e;
+};
+
+template <std::size_t N> constexpr std::size_t Riccati_kkt<N>::nx;
+template <std::size_t N> constexpr std::size_t Riccati_kkt<N>::nu;
+template <std::size_t N> constexpr std::size_t Riccati_kkt<N>::ne;
+
+#endif  // RICCATI_KKT_H
@@ -0,0 +1,107 @@
+#include "segment_index.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace {
+
+typedef Eigen::AlignedBox2d Box;
+
+// AlignedBox gives squared distances to a point, so the segment distances
+// are squared to compare with them.
+
+// For BVMinimize: the closest segment to a point. Boxes farther away than
+// the best segment so far are not opened.
+struct Closest_minimizer {
+	typedef double Scalar;
+
+	Closest_minimizer(const Segment_index &index, double x, double y) : index(index), point(x, y) {
+		best.segment = 0;
+		best.t = 0.0;
+		best.distance = std::numeric_limits<double>::max();
+	}
+
+	double minimumOnVolume(const Box &box) const { return box.squaredExteriorDistance(point); }
+
+	double minimumOnObject(int segment) {
+		Segment_index::Closest_point closest = index.OnSegment(segment, point.x(), point.y());
+		closest.distance *= closest.distance;
+		if (closest.distance < best.distance) {
+			best = closest;
+		}
+		return closest.distance;
+	}
+
+	const Segment_index &index;
+	const Eigen::Vector2d point;
+	Segment_index::Closest_point best;
+};
+
+// For BVIntersect: the segments within a radius of a point.
+struct Within_intersector {
+	Within_intersector(const Segment_index &index, double x, double y, double radius,
+	                   std::vector<std::size_t> &segments)
+		: index(index), point(x, y), squared_radius(radius * radius), segments(segments) {}
+
+	bool intersectVolume(const Box &box) const { return box.squaredExteriorDistance(point) <= squared_radius; }
+
+	bool intersectObject(int segment) {
+		const double distance = index.OnSegment(segment, point.x(), point.y()).distance;
+		if (distance * distance <= squared_radius) {
+			segments.push_back(segment);
+		}
+		// Never stop early.
+		return false;
+	}
+
+	const Segment_index &index;
+	const Eigen::Vector2d point;
+	const double squared_radius;
+	std::vector<std::size_t> &segments;
+};
+
+}  // namespace
+
+Segment_index::Segment_index() : n_segments_(0) {}
+
+void Segment_index::Build(const double *x, const double *y, std::size_t n, bool closed) {
+	x_.assign(x, x + n);
+	y_.assign(y, y + n);
+	n_segments_ = n < 2 ? 0 : closed ? n : n - 1;
+
+	std::vector<int> segments(n_segments_);
+	std::vector<Box, Eigen::aligned_allocator<Box> > boxes(n_segments_);
+	for (std::size_t i = 0; i < n_segments_; i++) {
+		const std::size_t j = i + 1 == n ? 0 : i + 1;
+		segments[i] = int(i);
+		boxes[i] = Box(Eigen::Vector2d(x_[i], y_[i]));
+		boxes[i].extend(Eigen::Vector2d(x_[j], y_[j]));
+	}
+	tree_.init(segments.begin(), segments.end(), boxes.begin(), boxes.end());
+}
+
+Segment_index::Closest_point Segment_index::OnSegment(std::size_t segment, double x, double y) const {
+	const std::size_t a = segment, b = segment + 1 == x_.size() ? 0 : segment + 1;
+	const double ex = x_[b] - x_[a], ey = y_[b] - y_[a];
+	const double length = ex * ex + ey * ey;
+	Closest_point closest;
+	closest.segment = segment;
+	closest.t = length > 0.0 ? std::max(0.0, std::min(1.0, ((x - x_[a]) * ex + (y - y_[a]) * ey) / length)) : 0.0;
+	const double px = x_[a] + closest.t * ex - x, py = y_[a] + closest.t * ey - y;
+	closest.distance = std::sqrt(px * px + py * py);
+	return closest;
+}
+
+Segment_index::Closest_point Segment_index::Closest(double x, double y) const {
+	Closest_minimizer minimizer(*this, x, y);
+	Eigen::BVMinimize(tree_, minimizer);
+	Closest_point closest = minimizer.best;
+	closest.distance = std::sqrt(closest.distance);
+	return closest;
+}
+
+void Segment_index::Within(double x, double y, double radius, std::vector<std::size_t> &segments) const {
+	segments.clear();
+	Within_intersector intersector(*this, x, y, radius, segments);
+	Eigen::BVIntersect(tree_, intersector);
+}
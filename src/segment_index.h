@@ -0,0 +1,57 @@
+#ifndef SEGMENT_INDEX_H
+#define SEGMENT_INDEX_H
+
+#include <cstddef>
+#include <vector>
+#include "Eigen-3.3/Eigen/Geometry"
+#include "Eigen-3.3/unsupported/Eigen/BVH"
+
+// A static spatial index over the segments of a polyline, for maps with far
+// more points than a linear scan can take per message. Segment i runs from
+// point i to point i + 1, and for a closed polyline the last one from the
+// last point back to the first.
+//
+// Build puts the segments' bounding boxes into a bounding volume hierarchy
+// (Eigen's unsupported KdBVH, a k-d tree over the box centers) once; queries
+// then descend it, which is logarithmic in the number of segments for
+// queries whose answers are near the query point.
+class Segment_index {
+ public:
+  // The point of a segment closest to a query point.
+  struct Closest_point {
+    std::size_t segment;
+    // Fraction of the way along the segment, in [0, 1].
+    double t;
+    double distance;
+  };
+
+  Segment_index();
+
+  // Indexes the polyline through the `n` points (x[i], y[i]). The points
+  // are copied, so the buffers need not outlive the index.
+  void Build(const double *x, const double *y, std::size_t n, bool closed);
+
+  bool Empty() const { return n_segments_ == 0; }
+  std::size_t Segments() const { return n_segments_; }
+
+  // The closest point to (x, y) on any segment. The index must not be
+  // empty.
+  Closest_point Closest(double x, double y) const;
+
+  // Replaces `segments` with those that pass within `radius` of (x, y), in
+  // no particular order.
+  void Within(double x, double y, double radius, std::vector<std::size_t> &segments) const;
+
+  // The closest point to (x, y) on the given segment.
+  Closest_point OnSegment(std::size_t segment, double x, double y) const;
+
+ private:
+  typedef Eigen::KdBVH<double, 2, int> Tree;
+
+  std::size_t n_segments_;
+  std::vector<double> x_;
+  std::vector<double> y_;
+  Tree tree_;
+};
+
+#endif  // SEGMENT_INDEX_H
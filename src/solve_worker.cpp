@@ -0,0 +1,144 @@
+#include "solve_worker.h"
+#include <algorithm>
+#include <iostream>
+#include <utility>
+
+Solve_worker::Solve_worker(uWS::Hub &h, Compute compute, int send_delay_ms)
+	: compute(std::move(compute)), send_delay_ms(send_delay_ms), loop(h.getLoop()),
+	  next_connection(0), stopping(false), has_job(false), n_posted(0), n_dropped(0) {
+	async = new uS::Async(loop);
+	async->setData(this);
+	async->start(OnReplies);
+	thread = std::thread(&Solve_worker::Run, this);
+}
+
+Solve_worker::~Solve_worker() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	wake.notify_one();
+	thread.join();
+	async->close();
+	// Including replies whose timer is still pending, which are in none of
+	// the lists; closing the timer keeps it from firing into this worker.
+	for (Reply *reply : all_replies) {
+		if (reply->timer) {
+			reply->timer->stop();
+			reply->timer->close();
+		}
+		delete reply;
+	}
+}
+
+void Solve_worker::Opened(Socket ws) {
+	Connection *connection = new Connection{next_connection++};
+	open_connections.insert(std::make_pair(connection->id, ws));
+	ws.setUserData(connection);
+}
+
+void Solve_worker::Closed(Socket ws) {
+	Connection *connection = static_cast<Connection *>(ws.getUserData());
+	if (connection) {
+		open_connections.erase(connection->id);
+		ws.setUserData(nullptr);
+		delete connection;
+	}
+}
+
+void Solve_worker::Post(Socket ws, const Telemetry &telemetry, Wire_format format) {
+	Connection *connection = static_cast<Connection *>(ws.getUserData());
+	if (!connection) {
+		return;
+	}
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (has_job) {
+			n_dropped++;
+		}
+		job.connection = connection->id;
+		job.format = format;
+		job.telemetry = telemetry;
+		job.received = std::chrono::steady_clock::now();
+		has_job = true;
+		n_posted++;
+	}
+	wake.notify_one();
+}
+
+void Solve_worker::Run() {
+	// Messages posted and dropped, reported every `report_every` replies.
+	const int report_every = 100;
+	int n_replies = 0;
+
+	while (true) {
+		Reply *reply;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			wake.wait(lock, [this]() { return has_job || stopping; });
+			if (stopping) {
+				return;
+			}
+			current = job;
+			has_job = false;
+			if (free_replies.empty()) {
+				reply = new Reply{this, 0, Wire_format::TEXT, std::string(), std::chrono::steady_clock::time_point(), nullptr};
+				all_replies.push_back(reply);
+			}
+			else {
+				reply = free_replies.back();
+				free_replies.pop_back();
+			}
+		}
+
+		reply->connection = current.connection;
+		reply->format = current.format;
+		reply->due = current.received + std::chrono::milliseconds(send_delay_ms);
+		compute(current.telemetry, current.received, current.format, reply->message);
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			replies.push_back(reply);
+			if (++n_replies == report_every) {
+				if (n_dropped > 0) {
+					std::cout << "solve worker: " << n_dropped << " of " << n_posted
+						<< " telemetry messages dropped as stale" << std::endl;
+				}
+				n_replies = 0;
+				n_posted = 0;
+				n_dropped = 0;
+			}
+		}
+		async->send();
+	}
+}
+
+void Solve_worker::OnReplies(uS::Async *async) {
+	Solve_worker *worker = static_cast<Solve_worker *>(async->getData());
+	{
+		std::lock_guard<std::mutex> lock(worker->mutex);
+		worker->ready.swap(worker->replies);
+	}
+	for (Reply *reply : worker->ready) {
+		if (!reply->timer) {
+			reply->timer = new uS::Timer(worker->loop);
+			reply->timer->setData(reply);
+		}
+		// Rounded up, so the delay is never shorter than asked.
+		long long left_us = std::chrono::duration_cast<std::chrono::microseconds>(
+			reply->due - std::chrono::steady_clock::now()).count();
+		reply->timer->start(OnSendTimer, int(std::max(0LL, (left_us + 999) / 1000)), 0);
+	}
+	worker->ready.clear();
+}
+
+void Solve_worker::OnSendTimer(uS::Timer *timer) {
+	Reply *reply = static_cast<Reply *>(timer->getData());
+	timer->stop();
+	auto connection = reply->worker->open_connections.find(reply->connection);
+	if (connection != reply->worker->open_connections.end()) {
+		uWS::OpCode op_code = reply->format == Wire_format::BINARY ? uWS::OpCode::BINARY : uWS::OpCode::TEXT;
+		connection->second.send(reply->message.data(), reply->message.length(), op_code);
+	}
+	std::lock_guard<std::mutex> lock(reply->worker->mutex);
+	reply->worker->free_replies.push_back(reply);
+}
@@ -0,0 +1,117 @@
+#ifndef SOLVE_WORKER_H
+#define SOLVE_WORKER_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <uWS/uWS.h>
+#include "telemetry.h"
+
+// Moves the controller off the uWS event loop.
+//
+// The loop thread posts parsed telemetry into a single-slot mailbox, copied
+// into preallocated storage; a message that is still waiting when the next
+// one arrives is dropped, since only the latest state of the car matters. A
+// dedicated thread takes messages out of the mailbox and writes the replies,
+// then wakes the loop through a uS::Async. The loop starts a uS::Timer per
+// reply that sends it `send_delay_ms` after its message was posted, instead
+// of sleeping, so the time spent solving is part of the delay rather than
+// added to it; a reply that is later than that goes out at once. Replies
+// for connections that closed in the meantime are discarded.
+//
+// Replies, their buffers and timers are recycled once sent, so a steady
+// stream of messages does not allocate. The destructor stops the timers of
+// replies not sent yet; those are dropped.
+//
+// Everything but the solver thread itself runs on the loop thread.
+class Solve_worker {
+ public:
+  typedef uWS::WebSocket<uWS::SERVER> Socket;
+  // Writes the reply to a message that was posted at `received` into
+  // `reply`, a reused buffer, in `format`.
+  typedef std::function<void(const Telemetry &, std::chrono::steady_clock::time_point received,
+                             Wire_format format, std::string &reply)> Compute;
+
+  Solve_worker(uWS::Hub &h, Compute compute, int send_delay_ms);
+
+  ~Solve_worker();
+
+  // Tracks `ws`, call from onConnection and onDisconnection.
+  void Opened(Socket ws);
+  void Closed(Socket ws);
+
+  // Hands `telemetry` from `ws` to the solver thread, the reply is sent in
+  // `format`.
+  void Post(Socket ws, const Telemetry &telemetry, Wire_format format);
+
+ private:
+  // Attached to the socket as user data.
+  struct Connection {
+    std::uint64_t id;
+  };
+
+  struct Job {
+    std::uint64_t connection;
+    Wire_format format;
+    Telemetry telemetry;
+    std::chrono::steady_clock::time_point received;
+  };
+
+  // Also the data of the timer that sends it.
+  struct Reply {
+    Solve_worker *worker;
+    std::uint64_t connection;
+    Wire_format format;
+    std::string message;
+    // When to send it.
+    std::chrono::steady_clock::time_point due;
+    // Created on the loop thread when the reply is first sent.
+    uS::Timer *timer;
+  };
+
+  void Run();
+  static void OnReplies(uS::Async *async);
+  static void OnSendTimer(uS::Timer *timer);
+
+  Compute compute;
+  const int send_delay_ms;
+  uS::Loop *loop;
+  uS::Async *async;
+
+  // Loop thread only.
+  std::map<std::uint64_t, Socket> open_connections;
+  // Swapped with `replies`, so both keep their capacity.
+  std::vector<Reply *> ready;
+  std::uint64_t next_connection;
+
+  // Shared with the solver thread, guarded by `mutex`.
+  std::mutex mutex;
+  std::condition_variable wake;
+  bool stopping;
+  // The mailbox.
+  bool has_job;
+  Job job;
+  // Written, waiting for the loop.
+  std::vector<Reply *> replies;
+  // Sent, ready for reuse.
+  std::vector<Reply *> free_replies;
+  // Every reply made so far, wherever it is: in one of the lists above, in
+  // `ready`, being written, or waiting for its timer. The worker owns them.
+  std::vector<Reply *> all_replies;
+  std::size_t n_posted;
+  std::size_t n_dropped;
+
+  // Solver thread only, the job being computed.
+  Job current;
+
+  std::thread thread;
+};
+
+#endif  // SOLVE_WORKER_H
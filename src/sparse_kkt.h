@@ -0,0 +1,256 @@
+#ifndef SPARSE_KKT_H
+#define SPARSE_KKT_H
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <vector>
+#include "Eigen-3.3/Eigen/Core"
+#include "Eigen-3.3/Eigen/SparseCore"
+#include "Eigen-3.3/Eigen/OrderingMethods"
+#include "Eigen-3.3/Eigen/SparseCholesky"
+#include "stage_qp.h"
+
+// SimplicialLDLT without an ordering, refactorized from the matrix itself.
+class Preordered_ldlt
+    : public Eigen::SimplicialLDLT<Eigen::SparseMatrix<double>, Eigen::Upper, Eigen::NaturalOrdering<int>> {
+ public:
+  // Like factorize(upper), with the pattern given to analyzePattern.
+  void FactorizeInPlace(const Eigen::SparseMatrix<double> &upper) {
+    this->template factorize_preordered<true>(upper);
+  }
+};
+
+// Kkt policy of Qp_ipm that keeps the KKT matrix of Dense_kkt in an
+// Eigen::SparseMatrix with a pattern fixed at construction. The fill-reducing
+// ordering and the symbolic analysis of SimplicialLDLT run once in the
+// constructor; afterwards Setup and Factor only write values in place through
+// cached positions and refactorize numerically.
+//
+// The matrix is stored already permuted by the AMD ordering, as the upper
+// triangle SimplicialLDLT factors, and refactorized through Preordered_ldlt:
+// SimplicialLDLT::factorize builds a temporary copy of its input on every
+// call even without an ordering. Right hand sides and solutions are permuted
+// through `order` on the way in and out, so once constructed the policy does
+// not allocate.
+//
+// LDLT without pivoting needs every ordering of the indefinite KKT matrix to
+// be factorizable, so it is made quasi-definite: +delta on the primal and
+// -delta on the dual diagonal. Two steps of iterative refinement against the
+// unperturbed matrix remove the effect on the solution.
+template <std::size_t N>
+class Sparse_kkt {
+ public:
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+  typedef Bicycle_model::Input Input;
+  typedef std::array<Input, N - 1> Inputs;
+  typedef Eigen::SparseMatrix<double> Matrix;
+
+  static constexpr std::size_t nx = Stage_qp<N>::nx;
+  static constexpr std::size_t nu = Stage_qp<N>::nu;
+  static constexpr std::size_t n_primal = N * nx + (N - 1) * nu;
+  static constexpr std::size_t n_dual = N * nx;
+  static constexpr std::size_t n = n_primal + n_dual;
+
+  Sparse_kkt() : kkt(n, n), rhs(n), solution(n), residual(n), correction(n) {
+    // Lower triangle of the KKT matrix. The dynamics blocks are taken dense,
+    // whatever the values of A and B. Identity blocks get their final value.
+    std::vector<Eigen::Triplet<double>> pattern;
+    for (std::size_t i = 0; i < n; i++) {
+      pattern.push_back(Eigen::Triplet<double>(i, i, 0.0));
+    }
+    for (std::size_t k = 0; k + 2 < N; k++) {
+      for (std::size_t i = 0; i < nu; i++) {
+        pattern.push_back(Eigen::Triplet<double>(U(k + 1) + i, U(k) + i, 0.0));
+      }
+    }
+    for (std::size_t i = 0; i < nx; i++) {
+      pattern.push_back(Eigen::Triplet<double>(Dual(0) + i, X(0) + i, 1.0));
+    }
+    for (std::size_t k = 0; k + 1 < N; k++) {
+      for (std::size_t i = 0; i < nx; i++) {
+        pattern.push_back(Eigen::Triplet<double>(Dual(k + 1) + i, X(k + 1) + i, 1.0));
+        for (std::size_t j = 0; j < nx; j++) {
+          pattern.push_back(Eigen::Triplet<double>(Dual(k + 1) + i, X(k) + j, 0.0));
+        }
+        for (std::size_t j = 0; j < nu; j++) {
+          pattern.push_back(Eigen::Triplet<double>(Dual(k + 1) + i, U(k) + j, 0.0));
+        }
+      }
+    }
+    Matrix lower(n, n);
+    lower.setFromTriplets(pattern.begin(), pattern.end());
+
+    // Row / column i of the KKT matrix is order[i] of `kkt`. The transposes
+    // sort the entries of every column.
+    Eigen::PermutationMatrix<Eigen::Dynamic, Eigen::Dynamic, int> inverse;
+    Eigen::AMDOrdering<int>()(lower.selfadjointView<Eigen::Lower>(), inverse);
+    const Eigen::PermutationMatrix<Eigen::Dynamic, Eigen::Dynamic, int> permutation = inverse.inverse();
+    order = permutation.indices();
+    Matrix permuted(n, n);
+    permuted.selfadjointView<Eigen::Upper>() = lower.selfadjointView<Eigen::Lower>().twistedBy(permutation);
+    Matrix transposed = permuted.transpose();
+    kkt = transposed.transpose();
+    kkt.makeCompressed();
+    ldlt.analyzePattern(kkt);
+
+    for (std::size_t i = 0; i < n; i++) {
+      diagonal[i] = Position(i, i);
+    }
+    for (std::size_t k = 0; k + 2 < N; k++) {
+      for (std::size_t i = 0; i < nu; i++) {
+        rate[k][i] = Position(U(k + 1) + i, U(k) + i);
+      }
+    }
+    for (std::size_t k = 0; k + 1 < N; k++) {
+      for (std::size_t i = 0; i < nx; i++) {
+        for (std::size_t j = 0; j < nx; j++) {
+          a[k][i * nx + j] = Position(Dual(k + 1) + i, X(k) + j);
+        }
+        for (std::size_t j = 0; j < nu; j++) {
+          b[k][i * nu + j] = Position(Dual(k + 1) + i, U(k) + j);
+        }
+      }
+    }
+  }
+
+  void Setup(const Stage_qp<N> &qp) {
+    double *values = kkt.valuePtr();
+    for (std::size_t k = 0; k < N; k++) {
+      for (std::size_t i = 0; i < nx; i++) {
+        values[diagonal[X(k) + i]] = qp.Q[i] + delta;
+      }
+    }
+    for (std::size_t k = 0; k + 1 < N; k++) {
+      input_diagonal[k] = qp.R + Input::Constant(delta);
+      if (k > 0) {
+        input_diagonal[k] += qp.W;
+      }
+      if (k + 2 < N) {
+        input_diagonal[k] += qp.W;
+        for (std::size_t i = 0; i < nu; i++) {
+          values[rate[k][i]] = -qp.W[i];
+        }
+      }
+    }
+    for (std::size_t i = 0; i < n_dual; i++) {
+      values[diagonal[n_primal + i]] = -delta;
+    }
+    for (std::size_t k = 0; k + 1 < N; k++) {
+      for (std::size_t i = 0; i < nx; i++) {
+        for (std::size_t j = 0; j < nx; j++) {
+          values[a[k][i * nx + j]] = -qp.A[k](i, j);
+        }
+        for (std::size_t j = 0; j < nu; j++) {
+          values[b[k][i * nu + j]] = -qp.B[k](i, j);
+        }
+      }
+    }
+  }
+
+  void Factor(const Stage_qp<N> &qp, const Inputs &sigma) {
+    double *values = kkt.valuePtr();
+    for (std::size_t k = 0; k + 1 < N; k++) {
+      for (std::size_t i = 0; i < nu; i++) {
+        values[diagonal[U(k) + i]] = input_diagonal[k][i] + sigma[k][i];
+      }
+    }
+    ldlt.FactorizeInPlace(kkt);
+  }
+
+  void Solve(const Stage_qp<N> &qp, const Inputs &r, Stage_trajectory<N> &z) {
+    for (std::size_t k = 0; k < N; k++) {
+      Scatter(X(k), -qp.q);
+    }
+    for (std::size_t k = 0; k + 1 < N; k++) {
+      Scatter(U(k), -r[k]);
+    }
+    Scatter(Dual(0), qp.x_init);
+    for (std::size_t k = 0; k + 1 < N; k++) {
+      Scatter(Dual(k + 1), qp.c[k]);
+    }
+
+    solution = ldlt.solve(rhs);
+    for (int refinement = 0; refinement < 2; refinement++) {
+      // Residual of the unperturbed system: take the regularization back out.
+      residual = rhs;
+      residual.noalias() -= kkt.template selfadjointView<Eigen::Upper>() * solution;
+      for (std::size_t i = 0; i < n; i++) {
+        residual[order[i]] += (i < n_primal ? delta : -delta) * solution[order[i]];
+      }
+      correction = ldlt.solve(residual);
+      solution += correction;
+    }
+
+    for (std::size_t k = 0; k < N; k++) {
+      Gather(X(k), z.x[k]);
+    }
+    for (std::size_t k = 0; k + 1 < N; k++) {
+      Gather(U(k), z.u[k]);
+    }
+  }
+
+ private:
+  static constexpr double delta = 1e-12;
+
+  static std::size_t X(std::size_t k) { return k * nx; }
+  static std::size_t U(std::size_t k) { return N * nx + k * nu; }
+  static std::size_t Dual(std::size_t k) { return n_primal + k * nx; }
+
+  // Position of entry (row, col) of the KKT matrix, row >= col, in
+  // kkt.valuePtr().
+  int Position(std::size_t row, std::size_t col) const {
+    const int i = std::min(order[row], order[col]), j = std::max(order[row], order[col]);
+    for (int p = kkt.outerIndexPtr()[j]; p < kkt.outerIndexPtr()[j + 1]; p++) {
+      if (kkt.innerIndexPtr()[p] == i) {
+        return p;
+      }
+    }
+    return -1;
+  }
+
+  // Writes the block of the right hand side starting at `start`.
+  template <typename Block>
+  void Scatter(std::size_t start, const Block &block) {
+    for (int i = 0; i < block.size(); i++) {
+      rhs[order[start + i]] = block[i];
+    }
+  }
+
+  // Reads the block of the solution starting at `start`.
+  template <typename Block>
+  void Gather(std::size_t start, Block &block) const {
+    for (int i = 0; i < block.size(); i++) {
+      block[i] = solution[order[start + i]];
+    }
+  }
+
+  // The KKT matrix permuted by `order`, upper triangle.
+  Matrix kkt;
+  Eigen::VectorXi order;
+  Preordered_ldlt ldlt;
+  // In the order of `kkt`.
+  Eigen::VectorXd rhs;
+  Eigen::VectorXd solution;
+  Eigen::VectorXd residual;
+  Eigen::VectorXd correction;
+
+  // Cached value positions.
+  std::array<int, n> diagonal;
+  std::array<std::array<int, nu>, N - 1> rate;
+  std::array<std::array<int, nx * nx>, N - 1> a;
+  std::array<std::array<int, nx * nu>, N - 1> b;
+
+  // Input diagonal without the barrier term.
+  Inputs input_diagonal;
+};
+
+template <std::size_t N> constexpr std::size_t Sparse_kkt<N>::nx;
+template <std::size_t N> constexpr std::size_t Sparse_kkt<N>::nu;
+template <std::size_t N> constexpr std::size_t Sparse_kkt<N>::n_primal;
+template <std::size_t N> constexpr std::size_t Sparse_kkt<N>::n_dual;
+template <std::size_t N> constexpr std::size_t Sparse_kkt<N>::n;
+template <std::size_t N> constexpr double Sparse_kkt<N>::delta;
+
+#endif  // SPARSE_KKT_H
@@ -0,0 +1,111 @@
+#ifndef STAGE_QP_H
+#define STAGE_QP_H
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <limits>
+#include "Eigen-3.3/Eigen/Core"
+#include "MPC_config.h"
+#include "MPC_solution.h"
+#include "bicycle_model.h"
+
+// States and inputs over a horizon of N steps: x_0 .. x_N-1, u_0 .. u_N-2.
+template <std::size_t N>
+struct Stage_trajectory {
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+  std::array<Bicycle_model::State, N> x;
+  std::array<Bicycle_model::Input, N - 1> u;
+};
+
+// The MPC problem with the model linearized along a trajectory:
+//
+//   min  sum_k 1/2 x_k' Q x_k + q' x_k
+//      + sum_k 1/2 u_k' R u_k
+//      + sum_k 1/2 (u_k+1 - u_k)' W (u_k+1 - u_k)
+//   s.t. x_0 = x_init
+//        x_k+1 = A_k x_k + B_k u_k + c_k
+//        lb <= u_k <= ub
+//
+// Q, R and W are diagonal and the same on every stage. This is the cost of
+// FG_eval written with a factor 1/2, so it is exact and only the dynamics are
+// approximated.
+template <std::size_t N>
+struct Stage_qp {
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+  typedef Bicycle_model::State State;
+  typedef Bicycle_model::Input Input;
+
+  static constexpr std::size_t nx = 6;
+  static constexpr std::size_t nu = 2;
+
+  State Q;
+  State q;
+  Input R;
+  Input W;
+  Input lb;
+  Input ub;
+
+  State x_init;
+  std::array<Bicycle_model::StateMatrix, N - 1> A;
+  std::array<Bicycle_model::InputMatrix, N - 1> B;
+  std::array<State, N - 1> c;
+
+  void SetCost(const MPC_config &config) {
+    Q << 0, 0, 0, 2 * config.pen_speed, 2 * config.pen_cte, 2 * config.pen_angle;
+    q << 0, 0, 0, -2 * config.pen_speed * config.ref_v, 0, 0;
+    R << 2 * config.pen_steering, 2 * config.pen_throttle;
+    W << 2 * config.pen_st_angle, 2 * config.pen_break;
+    lb << -config.max_steering, -config.max_throttle;
+    ub << config.max_steering, config.max_throttle;
+  }
+
+  // Linearizes the dynamics along `z`, which also becomes consistent with the
+  // linear model: x_k+1 = Step(x_k, u_k) from x_0 = x_init.
+  void Linearize(const Bicycle_model::State &state,
+                 const Bicycle_model::Coeffs &coeffs,
+                 const MPC_config &config, Stage_trajectory<N> &z) {
+    x_init = state;
+    z.x[0] = state;
+    for (std::size_t k = 0; k + 1 < N; k++) {
+      Bicycle_model::Linearize(z.x[k], z.u[k], coeffs, config, A[k], B[k], c[k]);
+      z.x[k + 1] = A[k] * z.x[k] + B[k] * z.u[k] + c[k];
+    }
+  }
+
+  // Largest violation of the constraints by `z`, infinite if it is not
+  // finite.
+  double Infeasibility(const Stage_trajectory<N> &z) const {
+    for (std::size_t k = 0; k < N; k++) {
+      if (!z.x[k].allFinite() || (k + 1 < N && !z.u[k].allFinite())) {
+        return std::numeric_limits<double>::infinity();
+      }
+    }
+    double violation = (z.x[0] - x_init).cwiseAbs().maxCoeff();
+    for (std::size_t k = 0; k + 1 < N; k++) {
+      violation = std::max(violation, (z.x[k + 1] - A[k] * z.x[k] - B[k] * z.u[k] - c[k]).cwiseAbs().maxCoeff());
+      violation = std::max(violation, (lb - z.u[k]).maxCoeff());
+      violation = std::max(violation, (z.u[k] - ub).maxCoeff());
+    }
+    return violation;
+  }
+};
+
+template <std::size_t N> constexpr std::size_t Stage_qp<N>::nx;
+template <std::size_t N> constexpr std::size_t Stage_qp<N>::nu;
+
+// A solver for Stage_qp. `z` holds the starting guess on input and the
+// solution on output, or the current iterate if the solver stopped at
+// `deadline`. Returns the number of iterations it took.
+template <std::size_t N>
+class Stage_qp_solver {
+ public:
+  virtual ~Stage_qp_solver() {}
+  virtual int Solve(const Stage_qp<N> &qp, Stage_trajectory<N> &z, MPC_clock::time_point deadline) = 0;
+  // Forgets anything kept from previous solves for the next one.
+  virtual void Reset() {}
+};
+
+#endif  // STAGE_QP_H
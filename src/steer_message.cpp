@@ -0,0 +1,435 @@
+#include "steer_message.h"
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "little_endian.h"
+
+namespace {
+
+// A floating point number f * 2^e with a 64-bit significand.
+struct Diy_fp {
+	std::uint64_t f;
+	int e;
+};
+
+Diy_fp Sub(Diy_fp x, Diy_fp y) {
+	return Diy_fp{x.f - y.f, x.e};
+}
+
+// x * y, rounded to the upper 64 bits of the product.
+Diy_fp Mul(Diy_fp x, Diy_fp y) {
+	const std::uint64_t u_lo = x.f & 0xFFFFFFFFu;
+	const std::uint64_t u_hi = x.f >> 32;
+	const std::uint64_t v_lo = y.f & 0xFFFFFFFFu;
+	const std::uint64_t v_hi = y.f >> 32;
+	const std::uint64_t p0 = u_lo * v_lo;
+	const std::uint64_t p1 = u_lo * v_hi;
+	const std::uint64_t p2 = u_hi * v_lo;
+	const std::uint64_t p3 = u_hi * v_hi;
+	std::uint64_t q = (p0 >> 32) + (p1 & 0xFFFFFFFFu) + (p2 & 0xFFFFFFFFu);
+	q += std::uint64_t(1) << 31;
+	return Diy_fp{p3 + (p2 >> 32) + (p1 >> 32) + (q >> 32), x.e + y.e + 64};
+}
+
+Diy_fp Normalize(Diy_fp x) {
+	while ((x.f >> 63) == 0) {
+		x.f <<= 1;
+		x.e--;
+	}
+	return x;
+}
+
+Diy_fp NormalizeTo(Diy_fp x, int e) {
+	return Diy_fp{x.f << (x.e - e), e};
+}
+
+// A positive finite `value` and the midpoints to its neighbours, m_minus
+// and m_plus, all with the exponent of the normalized m_plus.
+struct Boundaries {
+	Diy_fp w;
+	Diy_fp m_minus;
+	Diy_fp m_plus;
+};
+
+Boundaries ComputeBoundaries(double value) {
+	const int bias = 1023 + 52;
+	const std::uint64_t hidden_bit = std::uint64_t(1) << 52;
+	std::uint64_t bits;
+	std::memcpy(&bits, &value, sizeof(bits));
+	const std::uint64_t biased_e = bits >> 52;
+	const std::uint64_t fraction = bits & (hidden_bit - 1);
+
+	const Diy_fp v = biased_e == 0 ? Diy_fp{fraction, 1 - bias}
+		: Diy_fp{fraction + hidden_bit, int(biased_e) - bias};
+	// The next smaller double is closer at powers of two.
+	const bool lower_is_closer = fraction == 0 && biased_e > 1;
+	const Diy_fp m_plus = Normalize(Diy_fp{2 * v.f + 1, v.e - 1});
+	const Diy_fp m_minus = lower_is_closer ? Diy_fp{4 * v.f - 1, v.e - 2} : Diy_fp{2 * v.f - 1, v.e - 1};
+	return Boundaries{Normalize(v), NormalizeTo(m_minus, m_plus.e), m_plus};
+}
+
+// Digit generation works on products with a binary exponent in
+// [alpha, gamma], so the integral part fits in 32 bits.
+const int alpha = -60;
+const int gamma = -32;
+
+// 10^k as a normalized Diy_fp, for every 8th k from -300 to 324.
+struct Cached_power {
+	std::uint64_t f;
+	int e;
+	int k;
+};
+
+const Cached_power cached_powers[] = {
+		{0xAB70FE17C79AC6CA, -1060,  -300},
+		{0xFF77B1FCBEBCDC4F, -1034,  -292},
+		{0xBE5691EF416BD60C, -1007,  -284},
+		{0x8DD01FAD907FFC3C,  -980,  -276},
+		{0xD3515C2831559A83,  -954,  -268},
+		{0x9D71AC8FADA6C9B5,  -927,  -260},
+		{0xEA9C227723EE8BCB,  -901,  -252},
+		{0xAECC49914078536D,  -874,  -244},
+		{0x823C12795DB6CE57,  -847,  -236},
+		{0xC21094364DFB5637,  -821,  -228},
+		{0x9096EA6F3848984F,  -794,  -220},
+		{0xD77485CB25823AC7,  -768,  -212},
+		{0xA086CFCD97BF97F4,  -741,  -204},
+		{0xEF340A98172AACE5,  -715,  -196},
+		{0xB23867FB2A35B28E,  -688,  -188},
+		{0x84C8D4DFD2C63F3B,  -661,  -180},
+		{0xC5DD44271AD3CDBA,  -635,  -172},
+		{0x936B9FCEBB25C996,  -608,  -164},
+		{0xDBAC6C247D62A584,  -582,  -156},
+		{0xA3AB66580D5FDAF6,  -555,  -148},
+		{0xF3E2F893DEC3F126,  -529,  -140},
+		{0xB5B5ADA8AAFF80B8,  -502,  -132},
+		{0x87625F056C7C4A8B,  -475,  -124},
+		{0xC9BCFF6034C13053,  -449,  -116},
+		{0x964E858C91BA2655,  -422,  -108},
+		{0xDFF9772470297EBD,  -396,  -100},
+		{0xA6DFBD9FB8E5B88F,  -369,   -92},
+		{0xF8A95FCF88747D94,  -343,   -84},
+		{0xB94470938FA89BCF,  -316,   -76},
+		{0x8A08F0F8BF0F156B,  -289,   -68},
+		{0xCDB02555653131B6,  -263,   -60},
+		{0x993FE2C6D07B7FAC,  -236,   -52},
+		{0xE45C10C42A2B3B06,  -210,   -44},
+		{0xAA242499697392D3,  -183,   -36},
+		{0xFD87B5F28300CA0E,  -157,   -28},
+		{0xBCE5086492111AEB,  -130,   -20},
+		{0x8CBCCC096F5088CC,  -103,   -12},
+		{0xD1B71758E219652C,   -77,    -4},
+		{0x9C40000000000000,   -50,     4},
+		{0xE8D4A51000000000,   -24,    12},
+		{0xAD78EBC5AC620000,     3,    20},
+		{0x813F3978F8940984,    30,    28},
+		{0xC097CE7BC90715B3,    56,    36},
+		{0x8F7E32CE7BEA5C70,    83,    44},
+		{0xD5D238A4ABE98068,   109,    52},
+		{0x9F4F2726179A2245,   136,    60},
+		{0xED63A231D4C4FB27,   162,    68},
+		{0xB0DE65388CC8ADA8,   189,    76},
+		{0x83C7088E1AAB65DB,   216,    84},
+		{0xC45D1DF942711D9A,   242,    92},
+		{0x924D692CA61BE758,   269,   100},
+		{0xDA01EE641A708DEA,   295,   108},
+		{0xA26DA3999AEF774A,   322,   116},
+		{0xF209787BB47D6B85,   348,   124},
+		{0xB454E4A179DD1877,   375,   132},
+		{0x865B86925B9BC5C2,   402,   140},
+		{0xC83553C5C8965D3D,   428,   148},
+		{0x952AB45CFA97A0B3,   455,   156},
+		{0xDE469FBD99A05FE3,   481,   164},
+		{0xA59BC234DB398C25,   508,   172},
+		{0xF6C69A72A3989F5C,   534,   180},
+		{0xB7DCBF5354E9BECE,   561,   188},
+		{0x88FCF317F22241E2,   588,   196},
+		{0xCC20CE9BD35C78A5,   614,   204},
+		{0x98165AF37B2153DF,   641,   212},
+		{0xE2A0B5DC971F303A,   667,   220},
+		{0xA8D9D1535CE3B396,   694,   228},
+		{0xFB9B7CD9A4A7443C,   720,   236},
+		{0xBB764C4CA7A44410,   747,   244},
+		{0x8BAB8EEFB6409C1A,   774,   252},
+		{0xD01FEF10A657842C,   800,   260},
+		{0x9B10A4E5E9913129,   827,   268},
+		{0xE7109BFBA19C0C9D,   853,   276},
+		{0xAC2820D9623BF429,   880,   284},
+		{0x80444B5E7AA7CF85,   907,   292},
+		{0xBF21E44003ACDD2D,   933,   300},
+		{0x8E679C2F5E44FF8F,   960,   308},
+		{0xD433179D9C8CB841,   986,   316},
+		{0x9E19DB92B4E31BA9,  1013,   324}
+};
+const int cached_powers_min_k = -300;
+const int cached_powers_k_step = 8;
+
+// A power of ten c = 10^k, such that the product of c and a Diy_fp with
+// exponent `e` has an exponent in [alpha, gamma].
+Cached_power CachedPowerFor(int e) {
+	// ceil(log10(2^(alpha - e - 1)))
+	const int f = alpha - e - 1;
+	const int k = (f * 78913) / (1 << 18) + (f > 0);
+	const int index = (-cached_powers_min_k + k + (cached_powers_k_step - 1)) / cached_powers_k_step;
+	return cached_powers[index];
+}
+
+// Largest power of ten `pow10` <= n, returns its number of digits.
+int LargestPow10(std::uint32_t n, std::uint32_t &pow10) {
+	static const std::uint32_t powers[] = {
+		1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000
+	};
+	int digits = 10;
+	while (digits > 1 && n < powers[digits - 1]) {
+		digits--;
+	}
+	pow10 = powers[digits - 1];
+	return digits;
+}
+
+// Moves the last digit towards w while it stays within the boundaries.
+void Round(char *digits, int length, std::uint64_t dist, std::uint64_t delta, std::uint64_t rest,
+	std::uint64_t ten_k) {
+	while (rest < dist && delta - rest >= ten_k &&
+		(rest + ten_k < dist || dist - rest > rest + ten_k - dist)) {
+		digits[length - 1]--;
+		rest += ten_k;
+	}
+}
+
+// Writes the shortest digits of w within (m_minus, m_plus), scaled so that
+// the value is digits * 10^exponent. The boundaries are only known to a few
+// units of the last place; `exact` is cleared if a shorter prefix fell within
+// that error, the digits may then be one longer than necessary.
+void GenerateDigits(char *digits, int &length, int &exponent, bool &exact, Diy_fp m_minus, Diy_fp w,
+	Diy_fp m_plus) {
+	const std::uint64_t slack = 4;
+	std::uint64_t delta = Sub(m_plus, m_minus).f;
+	std::uint64_t dist = Sub(m_plus, w).f;
+
+	const Diy_fp one{std::uint64_t(1) << -m_plus.e, m_plus.e};
+	std::uint32_t p1 = std::uint32_t(m_plus.f >> -one.e);
+	std::uint64_t p2 = m_plus.f & (one.f - 1);
+
+	std::uint32_t pow10;
+	int n = LargestPow10(p1, pow10);
+	while (n > 0) {
+		digits[length++] = char('0' + p1 / pow10);
+		p1 %= pow10;
+		n--;
+		const std::uint64_t rest = (std::uint64_t(p1) << -one.e) + p2;
+		if (rest <= delta) {
+			exponent += n;
+			Round(digits, length, dist, delta, rest, std::uint64_t(pow10) << -one.e);
+			return;
+		}
+		// The prefix is just short of m_minus, or the next one just above
+		// m_plus.
+		const std::uint64_t ten_n = std::uint64_t(pow10) << -one.e;
+		if (rest - delta <= slack || ten_n - rest <= slack) {
+			exact = false;
+		}
+		pow10 /= 10;
+	}
+
+	int m = 0;
+	std::uint64_t unit = 1;
+	while (true) {
+		p2 *= 10;
+		digits[length++] = char('0' + (p2 >> -one.e));
+		p2 &= one.f - 1;
+		m++;
+		delta *= 10;
+		dist *= 10;
+		unit *= 10;
+		if (p2 <= delta) {
+			break;
+		}
+		if (p2 - delta <= slack * unit || one.f - p2 <= slack * unit) {
+			exact = false;
+		}
+	}
+	exponent -= m;
+	Round(digits, length, dist, delta, p2, one.f);
+}
+
+// Grisu2 for a positive finite value, returns false if the digits might not
+// be the shortest.
+bool Grisu2(double value, char *digits, int &length, int &exponent) {
+	const Boundaries b = ComputeBoundaries(value);
+	const Cached_power cached = CachedPowerFor(b.m_plus.e);
+	const Diy_fp c{cached.f, cached.e};
+	const Diy_fp w = Mul(b.w, c);
+	const Diy_fp w_minus = Mul(b.m_minus, c);
+	const Diy_fp w_plus = Mul(b.m_plus, c);
+	// Shrink the boundaries by the error of the products.
+	length = 0;
+	exponent = -cached.k;
+	bool exact = true;
+	GenerateDigits(digits, length, exponent, exact, Diy_fp{w_minus.f + 1, w_minus.e}, w,
+		Diy_fp{w_plus.f - 1, w_plus.e});
+	return exact;
+}
+
+// The shortest digits by trial, for the few values Grisu2 is unsure about.
+// The candidates are read back as an integer significand and an exponent,
+// which does not depend on the locale's decimal point.
+void ShortestByTrial(double value, char *digits, int &length, int &exponent) {
+	char text[32];
+	for (int precision = 1; precision <= 17; precision++) {
+		snprintf(text, sizeof(text), "%.*e", precision - 1, value);
+		length = 0;
+		const char *p = text;
+		for (; *p != 'e'; p++) {
+			if (*p >= '0' && *p <= '9') {
+				digits[length++] = *p;
+			}
+		}
+		exponent = std::atoi(p + 1) - (length - 1);
+		char candidate[32];
+		std::memcpy(candidate, digits, length);
+		snprintf(candidate + length, sizeof(candidate) - length, "e%d", exponent);
+		if (std::strtod(candidate, nullptr) == value) {
+			return;
+		}
+	}
+}
+
+char *Write(char *out, const char *text, std::size_t length) {
+	std::memcpy(out, text, length);
+	return out + length;
+}
+
+void Append(std::string &out, const char *text) {
+	out.append(text, std::strlen(text));
+}
+
+void AppendArray(std::string &out, const char *key, const double *values, std::size_t n) {
+	Append(out, key);
+	out += '[';
+	char number[max_double_length];
+	for (std::size_t i = 0; i < n; i++) {
+		if (i > 0) {
+			out += ',';
+		}
+		out.append(number, WriteDouble(values[i], number) - number);
+	}
+	out += ']';
+}
+
+void StoreDoubles(char *&p, const double *values, std::size_t n) {
+	for (std::size_t i = 0; i < n; i++) {
+		StoreDouble(values[i], p);
+		p += 8;
+	}
+}
+
+// The BINARY layout in steer_message.h.
+void WriteBinary(double steering_angle, double throttle,
+	const double *mpc_x, const double *mpc_y, std::size_t n_mpc,
+	const double *next_x, const double *next_y, std::size_t n_next,
+	std::string &out) {
+	const std::size_t header = 16;
+	out.resize(header + 8 * (2 + 2 * n_mpc + 2 * n_next));
+	char *p = &out[0];
+	std::memcpy(p, "MPCS", 4);
+	StoreU32(std::uint32_t(n_mpc), p + 4);
+	StoreU32(std::uint32_t(n_next), p + 8);
+	StoreU32(0, p + 12);
+	p += header;
+	StoreDouble(steering_angle, p);
+	StoreDouble(throttle, p + 8);
+	p += 16;
+	StoreDoubles(p, mpc_x, n_mpc);
+	StoreDoubles(p, mpc_y, n_mpc);
+	StoreDoubles(p, next_x, n_next);
+	StoreDoubles(p, next_y, n_next);
+}
+
+}  // namespace
+
+char *WriteDouble(double value, char *out) {
+	if (!std::isfinite(value)) {
+		return Write(out, "null", 4);
+	}
+	if (std::signbit(value)) {
+		*out++ = '-';
+		value = -value;
+	}
+	if (value == 0.0) {
+		return Write(out, "0.0", 3);
+	}
+
+	char digits[18];
+	int length, exponent;
+	if (!Grisu2(value, digits, length, exponent)) {
+		ShortestByTrial(value, digits, length, exponent);
+	}
+	while (length > 1 && digits[length - 1] == '0') {
+		length--;
+		exponent++;
+	}
+
+	// %.15g: scientific notation below 1e-4 and from 1e15 on, otherwise
+	// fixed. Integers get a ".0".
+	const int precision = 15;
+	const int x = exponent + length - 1;
+	if (x < -4 || x >= precision) {
+		*out++ = digits[0];
+		if (length > 1) {
+			*out++ = '.';
+			out = Write(out, digits + 1, length - 1);
+		}
+		*out++ = 'e';
+		*out++ = x < 0 ? '-' : '+';
+		int magnitude = x < 0 ? -x : x;
+		if (magnitude >= 100) {
+			*out++ = char('0' + magnitude / 100);
+		}
+		*out++ = char('0' + magnitude / 10 % 10);
+		*out++ = char('0' + magnitude % 10);
+	}
+	else if (x < 0) {
+		out = Write(out, "0.", 2);
+		for (int i = 0; i < -x - 1; i++) {
+			*out++ = '0';
+		}
+		out = Write(out, digits, length);
+	}
+	else if (length <= x + 1) {
+		out = Write(out, digits, length);
+		for (int i = length; i < x + 1; i++) {
+			*out++ = '0';
+		}
+		out = Write(out, ".0", 2);
+	}
+	else {
+		out = Write(out, digits, x + 1);
+		*out++ = '.';
+		out = Write(out, digits + x + 1, length - x - 1);
+	}
+	return out;
+}
+
+void WriteSteer(double steering_angle, double throttle,
+	const double *mpc_x, const double *mpc_y, std::size_t n_mpc,
+	const double *next_x, const double *next_y, std::size_t n_next,
+	Wire_format format, std::string &out) {
+	if (format == Wire_format::BINARY) {
+		WriteBinary(steering_angle, throttle, mpc_x, mpc_y, n_mpc, next_x, next_y, n_next, out);
+		return;
+	}
+	out.clear();
+	AppendArray(out, "42[\"steer\",{\"mpc_x\":", mpc_x, n_mpc);
+	AppendArray(out, ",\"mpc_y\":", mpc_y, n_mpc);
+	AppendArray(out, ",\"next_x\":", next_x, n_next);
+	AppendArray(out, ",\"next_y\":", next_y, n_next);
+	char number[max_double_length];
+	Append(out, ",\"steering_angle\":");
+	out.append(number, WriteDouble(steering_angle, number) - number);
+	Append(out, ",\"throttle\":");
+	out.append(number, WriteDouble(throttle, number) - number);
+	Append(out, "}]");
+}
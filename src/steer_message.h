@@ -0,0 +1,50 @@
+#ifndef STEER_MESSAGE_H
+#define STEER_MESSAGE_H
+
+#include <cstddef>
+#include <string>
+#include "telemetry.h"
+
+// Serializes the reply to a telemetry event without nlohmann::json. As TEXT:
+//
+//   42["steer",{"mpc_x":[...],"mpc_y":[...],"next_x":[...],"next_y":[...],
+//               "steering_angle":...,"throttle":...}]
+//
+// in the layout json::dump produced, keys sorted. As BINARY, little-endian:
+//
+//   offset  type             field
+//        0  char[4]          "MPCS"
+//        4  uint32           n_mpc
+//        8  uint32           n_next
+//       12  uint32           0
+//       16  float64[2]       steering_angle, throttle
+//       32  float64[n_mpc]   mpc_x, then mpc_y
+//           float64[n_next]  next_x, then next_y
+//
+// `out` is cleared and appended to, so a string that is reused keeps its
+// capacity and writing does not allocate once it is large enough.
+void WriteSteer(double steering_angle, double throttle,
+                const double *mpc_x, const double *mpc_y, std::size_t n_mpc,
+                const double *next_x, const double *next_y, std::size_t n_next,
+                Wire_format format, std::string &out);
+
+// Longest output of WriteDouble, e.g. "-2.2250738585072014e-308".
+const std::size_t max_double_length = 25;
+
+// Writes `value` the way json::dump does, but with the shortest digits that
+// read back as the same double instead of 15 significant digits, and
+// independent of the locale. Returns the end of the output, which is not
+// null-terminated.
+//
+// Where 15 digits already round-tripped the output is identical to
+// json::dump's "%.15g", with ".0" appended to integers and "null" for
+// infinities and NaN; longer values get 16 or 17 digits in the same layout.
+// Subnormals may come out shorter than "%.15g" wrote them. test_steer_message
+// checks both against json::dump.
+// The digits come from Grisu2 (Loitsch, "Printing Floating-Point Numbers
+// Quickly and Accurately with Integers", 2010), which in rare cases returns
+// a digit more than necessary; those are detected and redone by trial with
+// snprintf and strtod.
+char *WriteDouble(double value, char *out);
+
+#endif  // STEER_MESSAGE_H
@@ -0,0 +1,301 @@
+#include "telemetry.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <string>
+#include <vector>
+#include "helpers.h"
+#include "json.hpp"
+#include "little_endian.h"
+
+using nlohmann::json;
+using std::string;
+using std::vector;
+
+namespace {
+
+// Longer numbers are left to the fallback.
+const std::size_t max_number_length = 63;
+
+// Cursor over the frame for the fast path. Every method returns false when
+// the input does not look the way the simulator writes it; the caller then
+// hands the frame to nlohmann::json instead.
+class Scanner {
+ public:
+	Scanner(const char *data, std::size_t length) : p(data), end(data + length) {}
+
+	// Consumes `c`, after white space.
+	bool Expect(char c) {
+		SkipSpace();
+		if (p == end || *p != c) {
+			return false;
+		}
+		p++;
+		return true;
+	}
+
+	// Consumes `text` as is.
+	bool ExpectLiteral(const char *text) {
+		std::size_t length = std::strlen(text);
+		if (std::size_t(end - p) < length || std::memcmp(p, text, length) != 0) {
+			return false;
+		}
+		p += length;
+		return true;
+	}
+
+	// A string without escapes, [begin, begin + length) without the quotes.
+	bool String(const char *&begin, std::size_t &length) {
+		if (!Expect('"')) {
+			return false;
+		}
+		begin = p;
+		for (; p != end && *p != '"'; p++) {
+			if (*p == '\\') {
+				return false;
+			}
+		}
+		if (p == end) {
+			return false;
+		}
+		length = p - begin;
+		p++;
+		return true;
+	}
+
+	// strtod on a null-terminated copy in a stack buffer, the frame itself is
+	// not terminated.
+	bool Number(double &value) {
+		SkipSpace();
+		char buffer[max_number_length + 1];
+		std::size_t n = 0;
+		while (p != end && n < max_number_length && IsNumberChar(*p)) {
+			buffer[n++] = *p++;
+		}
+		if (n == 0 || (p != end && IsNumberChar(*p))) {
+			return false;
+		}
+		buffer[n] = '\0';
+		char *number_end;
+		value = std::strtod(buffer, &number_end);
+		return number_end == buffer + n;
+	}
+
+	// An array of at most `capacity` numbers, stored to `values` unless it is
+	// null.
+	bool Numbers(double *values, std::size_t capacity, std::size_t &count) {
+		if (!Expect('[')) {
+			return false;
+		}
+		count = 0;
+		if (Expect(']')) {
+			return true;
+		}
+		do {
+			double value;
+			if (count == capacity || !Number(value)) {
+				return false;
+			}
+			if (values) {
+				values[count] = value;
+			}
+			count++;
+		} while (Expect(','));
+		return Expect(']');
+	}
+
+	// A number or an array of numbers that is not needed.
+	bool Skip() {
+		SkipSpace();
+		std::size_t count;
+		double value;
+		return p != end && *p == '[' ? Numbers(nullptr, std::size_t(-1), count) : Number(value);
+	}
+
+	bool AtEnd() {
+		SkipSpace();
+		return p == end;
+	}
+
+ private:
+	void SkipSpace() {
+		while (p != end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r')) {
+			p++;
+		}
+	}
+
+	static bool IsNumberChar(char c) {
+		return (c >= '0' && c <= '9') || c == '-' || c == '+' || c == '.' || c == 'e' || c == 'E';
+	}
+
+	const char *p;
+	const char *end;
+};
+
+bool Is(const char *name, std::size_t length, const char *key) {
+	return std::strlen(key) == length && std::memcmp(name, key, length) == 0;
+}
+
+// The fast path. Returns false to fall back, `frame` is only set on success.
+bool Scan(const char *data, std::size_t length, Telemetry &telemetry, Telemetry_frame &frame) {
+	Scanner in(data, length);
+	if (!in.ExpectLiteral("42[\"telemetry\",")) {
+		return false;
+	}
+	if (in.ExpectLiteral("null]")) {
+		if (!in.AtEnd()) {
+			return false;
+		}
+		frame = Telemetry_frame::MANUAL;
+		return true;
+	}
+	if (!in.Expect('{')) {
+		return false;
+	}
+
+	// One bit per field of Telemetry.
+	enum { PTSX = 1, PTSY = 2, X = 4, Y = 8, PSI = 16, SPEED = 32, STEERING = 64, THROTTLE = 128 };
+	const unsigned all = 255;
+	unsigned seen = 0;
+	std::size_t n_ptsx = 0, n_ptsy = 0;
+	do {
+		const char *name;
+		std::size_t name_length;
+		if (!in.String(name, name_length) || !in.Expect(':')) {
+			return false;
+		}
+		bool ok;
+		if (Is(name, name_length, "ptsx")) {
+			ok = in.Numbers(telemetry.ptsx.data(), Telemetry::max_waypoints, n_ptsx);
+			seen |= PTSX;
+		}
+		else if (Is(name, name_length, "ptsy")) {
+			ok = in.Numbers(telemetry.ptsy.data(), Telemetry::max_waypoints, n_ptsy);
+			seen |= PTSY;
+		}
+		else if (Is(name, name_length, "x")) {
+			ok = in.Number(telemetry.x);
+			seen |= X;
+		}
+		else if (Is(name, name_length, "y")) {
+			ok = in.Number(telemetry.y);
+			seen |= Y;
+		}
+		else if (Is(name, name_length, "psi")) {
+			ok = in.Number(telemetry.psi);
+			seen |= PSI;
+		}
+		else if (Is(name, name_length, "speed")) {
+			ok = in.Number(telemetry.speed);
+			seen |= SPEED;
+		}
+		else if (Is(name, name_length, "steering_angle")) {
+			ok = in.Number(telemetry.steering_angle);
+			seen |= STEERING;
+		}
+		else if (Is(name, name_length, "throttle")) {
+			ok = in.Number(telemetry.throttle);
+			seen |= THROTTLE;
+		}
+		else {
+			// e.g. psi_unity
+			ok = in.Skip();
+		}
+		if (!ok) {
+			return false;
+		}
+	} while (in.Expect(','));
+
+	if (!in.Expect('}') || !in.Expect(']') || !in.AtEnd() || seen != all || n_ptsx != n_ptsy ||
+		n_ptsx < Telemetry::min_waypoints) {
+		return false;
+	}
+	telemetry.n_waypoints = n_ptsx;
+	frame = Telemetry_frame::TELEMETRY;
+	return true;
+}
+
+// The way main used to parse every frame.
+Telemetry_frame ParseJson(const char *data, std::size_t length, Telemetry &telemetry) {
+	// "42" at the start of the message means there's a websocket message event.
+	// The 4 signifies a websocket message
+	// The 2 signifies a websocket event
+	string sdata(data, length);
+	if (!(sdata.size() > 2 && sdata[0] == '4' && sdata[1] == '2')) {
+		return Telemetry_frame::NONE;
+	}
+	string s = hasData(sdata);
+	if (s == "") {
+		return Telemetry_frame::MANUAL;
+	}
+	try {
+		auto j = json::parse(s);
+		if (j[0].get<string>() != "telemetry") {
+			return Telemetry_frame::NONE;
+		}
+		// j[1] is the data JSON object
+		vector<double> ptsx = j[1]["ptsx"];
+		vector<double> ptsy = j[1]["ptsy"];
+		if (ptsx.size() != ptsy.size() || ptsx.size() < Telemetry::min_waypoints ||
+			ptsx.size() > Telemetry::max_waypoints) {
+			return Telemetry_frame::NONE;
+		}
+		std::copy(ptsx.begin(), ptsx.end(), telemetry.ptsx.begin());
+		std::copy(ptsy.begin(), ptsy.end(), telemetry.ptsy.begin());
+		telemetry.n_waypoints = ptsx.size();
+		telemetry.x = j[1]["x"];
+		telemetry.y = j[1]["y"];
+		telemetry.psi = j[1]["psi"];
+		telemetry.speed = j[1]["speed"];
+		telemetry.steering_angle = j[1]["steering_angle"];
+		telemetry.throttle = j[1]["throttle"];
+	}
+	catch (const std::exception &) {
+		return Telemetry_frame::NONE;
+	}
+	return Telemetry_frame::TELEMETRY;
+}
+
+// The BINARY layout in telemetry.h.
+Telemetry_frame ParseBinary(const char *data, std::size_t length, Telemetry &telemetry) {
+	const std::size_t header = 8;
+	const std::size_t n_scalars = 6;
+	if (length < header + 8 * n_scalars || std::memcmp(data, "MPCT", 4) != 0) {
+		return Telemetry_frame::NONE;
+	}
+	const std::uint32_t n = LoadU32(data + 4);
+	if (n < Telemetry::min_waypoints || n > Telemetry::max_waypoints ||
+		length != header + 8 * (n_scalars + 2 * n)) {
+		return Telemetry_frame::NONE;
+	}
+	const char *p = data + header;
+	telemetry.x = LoadDouble(p);
+	telemetry.y = LoadDouble(p + 8);
+	telemetry.psi = LoadDouble(p + 16);
+	telemetry.speed = LoadDouble(p + 24);
+	telemetry.steering_angle = LoadDouble(p + 32);
+	telemetry.throttle = LoadDouble(p + 40);
+	p += 8 * n_scalars;
+	for (std::uint32_t i = 0; i < n; i++) {
+		telemetry.ptsx[i] = LoadDouble(p + 8 * i);
+		telemetry.ptsy[i] = LoadDouble(p + 8 * (n + i));
+	}
+	telemetry.n_waypoints = n;
+	return Telemetry_frame::TELEMETRY;
+}
+
+}  // namespace
+
+Telemetry_frame ParseTelemetry(const char *data, std::size_t length, Wire_format format,
+	Telemetry &telemetry) {
+	if (format == Wire_format::BINARY) {
+		return ParseBinary(data, length, telemetry);
+	}
+	Telemetry_frame frame;
+	if (Scan(data, length, telemetry, frame)) {
+		return frame;
+	}
+	return ParseJson(data, length, telemetry);
+}
@@ -0,0 +1,71 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <array>
+#include <cstddef>
+
+// The simulator's telemetry event, `42["telemetry",{...}]`, with the fields
+// main uses. Fixed capacity, so it can be parsed into and copied without
+// touching the heap.
+struct Telemetry {
+  // The simulator sends 6 waypoints.
+  static constexpr std::size_t max_waypoints = 32;
+  // The cubic reference main fits through them needs 4.
+  static constexpr std::size_t min_waypoints = 4;
+
+  // Waypoints in map coordinates.
+  std::array<double, max_waypoints> ptsx;
+  std::array<double, max_waypoints> ptsy;
+  std::size_t n_waypoints;
+  double x;
+  double y;
+  double psi;
+  double speed;
+  double steering_angle;
+  double throttle;
+};
+
+// How a frame is encoded. Replies use the format of the telemetry they
+// answer, so a client picks binary by sending binary frames; text is what the
+// Unity simulator speaks.
+enum class Wire_format {
+  // socket.io events in JSON, websocket TEXT frames.
+  TEXT,
+  // The fixed layouts below and in steer_message.h, websocket BINARY frames.
+  BINARY
+};
+
+// What a websocket frame turned out to be.
+enum class Telemetry_frame {
+  // Not a socket.io event, or another event than telemetry: no reply.
+  NONE,
+  // An event without data, the simulator is in manual mode.
+  MANUAL,
+  // Telemetry, written to the output struct.
+  TELEMETRY
+};
+
+// Parses the frame `data` of `length` bytes, which is not null-terminated,
+// into `telemetry`.
+//
+// TEXT frames laid out the way the simulator writes them, an object of
+// numbers and arrays of numbers, are scanned in place without allocating.
+// Anything else goes through nlohmann::json as before, which also decides
+// between MANUAL and NONE the way hasData did.
+//
+// A BINARY frame is telemetry in this little-endian layout, and nothing
+// else; its length has to match n exactly:
+//
+//   offset  type        field
+//        0  char[4]     "MPCT"
+//        4  uint32      n, the number of waypoints
+//        8  float64[6]  x, y, psi, speed, steering_angle, throttle
+//       56  float64[n]  ptsx
+//   56 + 8n float64[n]  ptsy
+//
+// A frame with fewer than Telemetry::min_waypoints or more than
+// Telemetry::max_waypoints waypoints, or one that fails to parse, is NONE.
+Telemetry_frame ParseTelemetry(const char *data, std::size_t length, Wire_format format,
+                               Telemetry &telemetry);
+
+#endif  // TELEMETRY_H
@@ -0,0 +1,124 @@
+#include <array>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include "frame_transform.h"
+#include "helpers.h"
+#include "latency.h"
+#include "MPC.h"
+#include "telemetry.h"
+
+// Checks that steady-state MPC::Solve with MPC_engine::RTI does not touch
+// the heap: after a few warm-up solves, a run of further solves with every
+// QP solver has to get by without a single allocation. The same goes for
+// the reference main fits per message: the waypoints moved into the car
+// frame, the fixed-capacity polyfit<3> and the batched polyeval.
+//
+// Allocations through operator new are counted by the replacement below.
+// Eigen allocates with malloc instead, so the target is built with
+// EIGEN_RUNTIME_NO_MALLOC and Eigen asserts on any heap allocation while it
+// is forbidden.
+//
+//   test_allocations
+//
+// Exits with a nonzero status if anything allocates.
+
+namespace {
+
+bool counting = false;
+long n_allocations = 0;
+
+}  // namespace
+
+void *operator new(std::size_t size) {
+	if (counting) {
+		n_allocations++;
+	}
+	void *p = std::malloc(size > 0 ? size : 1);
+	if (!p) {
+		throw std::bad_alloc();
+	}
+	return p;
+}
+
+void operator delete(void *p) noexcept {
+	std::free(p);
+}
+
+namespace {
+
+// Starts counting allocations, both ours and Eigen's.
+void BeginCount() {
+	n_allocations = 0;
+	counting = true;
+	Eigen::internal::set_is_malloc_allowed(false);
+}
+
+// Stops counting, returns the allocations since BeginCount.
+long EndCount() {
+	Eigen::internal::set_is_malloc_allowed(true);
+	counting = false;
+	return n_allocations;
+}
+
+// What main does with the waypoints of a message, `n` times.
+void FitReferences(int n) {
+	const std::array<double, 6> ptsx = {{-32.16, -43.49, -61.09, -78.29, -93.05, -107.79}};
+	const std::array<double, 6> ptsy = {{113.36, 105.94, 92.89, 78.73, 65.34, 50.57}};
+	const int num_ref_pts = 25;
+	std::array<double, num_ref_pts> next_x;
+	std::array<double, num_ref_pts> next_y;
+	for (int i = 0; i < num_ref_pts; i++) {
+		next_x[i] = 2.0 * i;
+	}
+	for (int i = 0; i < n; i++) {
+		Fit_points<Telemetry::max_waypoints> waypoints_x(ptsx.size());
+		Fit_points<Telemetry::max_waypoints> waypoints_y(ptsy.size());
+		MapToCar(Pose{-40.62 + 0.01 * i, 108.73, 3.733651}, ptsx.data(), ptsy.data(), ptsx.size(),
+			waypoints_x.data(), waypoints_y.data());
+		Eigen::Matrix<double, 4, 1> coeffs = polyfit<3>(waypoints_x, waypoints_y);
+		polyeval(coeffs, next_x.data(), next_y.data(), num_ref_pts);
+	}
+}
+
+}  // namespace
+
+int main() {
+	const int n_warm_up = 5;
+	const int n_counted = 100;
+
+	int failures = 0;
+	for (const MPC_qp_solver_name &qp : qp_solver_names) {
+		MPC_config config;
+		config.engine = MPC_engine::RTI;
+		config.qp_solver = qp.solver;
+		MPC<10> mpc(config);
+
+		// A gentle curve, approached from off the center line.
+		MPC<10>::Coeffs coeffs;
+		coeffs << 1.0, 0.1, 0.001, -1e-5;
+		for (int i = 0; i < n_warm_up + n_counted; i++) {
+			MPC<10>::State state = PredictState(40.0, 0.01, 0.2, 1.0 - 0.01 * i, -0.1, config);
+			if (i == n_warm_up) {
+				BeginCount();
+			}
+			mpc.Solve(state, coeffs);
+		}
+		const long allocations = EndCount();
+
+		std::printf("%-12s %ld allocations in %d solves\n", qp.name, allocations, n_counted);
+		if (allocations != 0) {
+			failures++;
+		}
+	}
+
+	FitReferences(n_warm_up);
+	BeginCount();
+	FitReferences(n_counted);
+	const long allocations = EndCount();
+	std::printf("%-12s %ld allocations in %d fits\n", "reference", allocations, n_counted);
+	if (allocations != 0) {
+		failures++;
+	}
+	return failures == 0 ? 0 : 1;
+}
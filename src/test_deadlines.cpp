@@ -0,0 +1,115 @@
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+#include "latency.h"
+#include "MPC.h"
+#include "MPC_frenet.h"
+#include "MPC_nlp.h"
+
+// Checks how the Ipopt engine of MPC and MPC_frenet ends solves cut short by
+// their deadline:
+//
+// - Past deadlines: Ipopt is not started, the last feasible plan
+//   (Fallback_plan) stands in with one step more per cycle, N - 2 cycles of
+//   FALLBACK, then FAILED, and the next solve with time for it converges.
+// - Deadlines a little ahead, doubling from 10 us: intermediate_callback
+//   stops Ipopt, and a solve that got to a feasible point (KeepIfBest)
+//   reports LIMIT_REACHED with actuations inside their bounds. None of them
+//   may be FAILED, since there is a plan to fall back on.
+//
+//   test_deadlines
+//
+// Exits with a nonzero status if any check fails.
+
+namespace {
+
+int failures = 0;
+
+void Expect(bool ok, const char *name, const char *what) {
+	if (!ok) {
+		failures++;
+		std::printf("%s: %s\n", name, what);
+	}
+}
+
+// `solve(deadline)` solves the same problem again and returns the solution
+// of a controller with horizon N.
+template <std::size_t N, class Solution, class Solve>
+void Check(const char *name, const MPC_config &config, Solve solve) {
+	const MPC_clock::time_point none = MPC_clock::time_point::max();
+	const MPC_clock::time_point past = MPC_clock::time_point::min();
+
+	// The plan the fallbacks come from.
+	const Solution &solved = solve(none);
+	Expect(!solved.Degraded(), name, "solve without a deadline degraded");
+	const std::vector<double> delta(solved.delta.data(), solved.delta.data() + N - 1);
+	const std::vector<double> a(solved.a.data(), solved.a.data() + N - 1);
+
+	// Cycle k acts on the inputs planned for step k.
+	for (std::size_t k = 1; k <= N - 2; k++) {
+		const Solution &solution = solve(past);
+		Expect(solution.status == MPC_status::FALLBACK && solution.iterations == 0, name,
+			"past deadline within the plan not FALLBACK");
+		Expect(solution.delta[0] == delta[k] && solution.a[0] == a[k], name,
+			"FALLBACK does not act on the plan's next inputs");
+	}
+	Expect(solve(past).status == MPC_status::FAILED, name, "past deadline after the plan not FAILED");
+	Expect(!solve(none).Degraded(), name, "solve after FAILED degraded");
+
+	int n_limit_reached = 0;
+	int n_fallback = 0;
+	for (double budget = 1e-5; budget < config.max_cpu_time; budget *= 2.0) {
+		// A fresh plan, so each of these starts with one to fall back on.
+		solve(none);
+		const MPC_clock::time_point deadline = MPC_clock::now() +
+			std::chrono::duration_cast<MPC_clock::duration>(std::chrono::duration<double>(budget));
+		const Solution &solution = solve(deadline);
+		Expect(solution.status != MPC_status::FAILED, name, "near deadline FAILED with a plan");
+		if (solution.status == MPC_status::LIMIT_REACHED) {
+			n_limit_reached++;
+			Expect(std::isfinite(solution.objective) && std::fabs(solution.delta[0]) <= config.max_steering + 1e-6 &&
+				std::fabs(solution.a[0]) <= config.max_throttle + 1e-6, name,
+				"LIMIT_REACHED outside the actuation bounds");
+		}
+		n_fallback += solution.status == MPC_status::FALLBACK;
+	}
+	Expect(n_limit_reached > 0, name, "no near deadline reached LIMIT_REACHED");
+	std::printf("%-10s N = %zu: %d near deadlines LIMIT_REACHED, %d FALLBACK\n", name, N, n_limit_reached,
+		n_fallback);
+}
+
+}  // namespace
+
+int main() {
+	MPC_config config;
+	config.engine = MPC_engine::IPOPT;
+
+	// Whatever stopped Ipopt, a feasible point kept is LIMIT_REACHED.
+	Expect(IpoptStatus(Ipopt::LOCAL_INFEASIBILITY, true) == MPC_status::LIMIT_REACHED &&
+		IpoptStatus(Ipopt::RESTORATION_FAILURE, true) == MPC_status::LIMIT_REACHED &&
+		IpoptStatus(Ipopt::RESTORATION_FAILURE, false) == MPC_status::FAILED, "IpoptStatus",
+		"feasible point not LIMIT_REACHED");
+
+	// A gentle curve, approached from off the center line, as in
+	// test_qp_solvers.
+	MPC<10> mpc(config);
+	MPC<10>::Coeffs coeffs;
+	coeffs << 1.0, 0.1, 0.001, -1e-5;
+	const MPC<10>::State state = PredictState(40.0, 0.01, 0.2, 2.0, -0.1, config);
+	Check<10, MPC_solution<10>>("MPC", config, [&](MPC_clock::time_point deadline) -> const MPC_solution<10> & {
+		return mpc.Solve(state, coeffs, deadline);
+	});
+
+	// The same on a left turn of 100 m radius.
+	MPC_frenet<10> frenet(config);
+	MPC_frenet<10>::Curvatures curvatures;
+	curvatures.setConstant(0.01);
+	const MPC_frenet<10>::State frenet_state = PredictFrenetState(0.0, 1.0, -0.1, 40.0, 0.01, 0.2, 0.01, config);
+	Check<10, Frenet_solution<10>>("MPC_frenet", config,
+		[&](MPC_clock::time_point deadline) -> const Frenet_solution<10> & {
+			return frenet.Solve(frenet_state, curvatures, deadline);
+		});
+
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,77 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include "latency.h"
+#include "MPC_frenet.h"
+#include "track.h"
+
+// Drives MPC_frenet once around the lake track, as main does with --frenet:
+// the curvatures ahead are looked up where the car gets to at its current
+// speed, and the car follows the solver's own model, so the next state is
+// the predicted one at the first step. Starts a meter off the center line
+// and turned away from it.
+//
+// Every solve has to end with a usable result (not FALLBACK or FAILED), the
+// car has to stay within `max_ey` of the center line, and the lap has to end
+// within `max_cycles`.
+//
+//   test_frenet lake_track_waypoints.csv
+//
+// Exits with a nonzero status if any check fails.
+
+int main(int argc, char *argv[]) {
+	if (argc < 2) {
+		std::printf("Usage: test_frenet lake_track_waypoints.csv\n");
+		return 1;
+	}
+	Track track;
+	if (!track.Load(argv[1])) {
+		std::printf("Failed to load %s\n", argv[1]);
+		return 1;
+	}
+
+	// About half the width of the lake track's road.
+	const double max_ey = 3.0;
+	const int max_cycles = 2000;
+
+	// The settings main runs --frenet with by default.
+	MPC_config config;
+	MPC_frenet<10> mpc(config);
+	const double dt = config.dt;
+	MPC_frenet<10>::State state = PredictFrenetState(0.0, 1.0, 0.1, 10.0, 0.0, 0.0, track.At(0.0).curvature, config);
+
+	int cycles = 0;
+	int failures = 0;
+	int degraded = 0;
+	double largest_ey = 0.0;
+	double sum_speed = 0.0;
+	for (; cycles < max_cycles && state[0] < track.Length(); cycles++) {
+		MPC_frenet<10>::Curvatures curvatures;
+		for (int k = 0; k < curvatures.size(); k++) {
+			curvatures[k] = track.At(state[0] + k * state[3] * dt).curvature;
+		}
+		const Frenet_solution<10> &solution = mpc.Solve(state, curvatures);
+		degraded += solution.Degraded();
+		if (solution.status == MPC_status::FALLBACK || solution.status == MPC_status::FAILED) {
+			if (failures++ < 10) {
+				std::printf("s %.1f: no usable solve, status %d\n", state[0], int(solution.status));
+			}
+		}
+		state << solution.s[1], solution.ey[1], solution.epsi[1], solution.v[1];
+		largest_ey = std::max(largest_ey, std::fabs(state[1]));
+		sum_speed += state[3];
+		if (!(std::fabs(state[1]) <= max_ey)) {
+			if (failures++ < 10) {
+				std::printf("s %.1f: ey %.3f off the track\n", state[0], state[1]);
+			}
+		}
+	}
+	if (!(state[0] >= track.Length())) {
+		failures++;
+		std::printf("lap not done after %d cycles, at s %.1f of %.1f\n", cycles, state[0], track.Length());
+	}
+
+	std::printf("lap of %.1f m in %d cycles, mean speed %.1f, largest |ey| %.3f, %d degraded solves, "
+		"%d failures\n", track.Length(), cycles, sum_speed / std::max(cycles, 1), largest_ey, degraded, failures);
+	return failures == 0 ? 0 : 1;
+}
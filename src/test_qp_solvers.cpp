@@ -0,0 +1,69 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include "latency.h"
+#include "MPC.h"
+
+// Checks that every QP solver of MPC_engine::RTI converges within its
+// default iteration limit at every horizon MPC.cpp instantiates: each one
+// has to report SOLVED and agree with the condensed interior point method on
+// the actuations, from a cold start and over the cycles that follow.
+//
+//   test_qp_solvers
+//
+// Exits with a nonzero status if any solver stops short or disagrees.
+
+namespace {
+
+// Largest accepted difference to the reference in either actuation.
+const double tolerance = 1e-6;
+
+// Returns the number of solvers that failed at horizon N.
+template <size_t N>
+int Check() {
+	MPC_config config;
+	config.engine = MPC_engine::RTI;
+	config.qp_solver = MPC_qp_solver::CONDENSED;
+
+	int failures = 0;
+	for (const MPC_qp_solver_name &qp : qp_solver_names) {
+		if (qp.solver == config.qp_solver) {
+			continue;
+		}
+		MPC_config qp_config = config;
+		qp_config.qp_solver = qp.solver;
+		MPC<N> mpc(qp_config);
+		MPC<N> expected(config);
+
+		// A gentle curve, approached from well off the center line, so the
+		// steering starts out at its bound.
+		typename MPC<N>::Coeffs coeffs;
+		coeffs << 1.0, 0.1, 0.001, -1e-5;
+		double error = 0.0;
+		int not_solved = 0;
+		for (int i = 0; i < 30; i++) {
+			typename MPC<N>::State state = PredictState(40.0, 0.01, 0.2, 5.0 - 0.1 * i, -0.1, config);
+			const MPC_solution<N> &solution = mpc.Solve(state, coeffs);
+			const MPC_solution<N> &want = expected.Solve(state, coeffs);
+			error = std::max(error, std::max(std::fabs(solution.delta[0] - want.delta[0]),
+				std::fabs(solution.a[0] - want.a[0])));
+			if (solution.status != MPC_status::SOLVED || want.status != MPC_status::SOLVED) {
+				not_solved++;
+			}
+		}
+
+		std::printf("N = %3zu %-12s largest difference %.3g, %d solves not SOLVED\n", N, qp.name,
+			error, not_solved);
+		if (!(error <= tolerance) || not_solved > 0) {
+			failures++;
+		}
+	}
+	return failures;
+}
+
+}  // namespace
+
+int main() {
+	int failures = Check<10>() + Check<20>() + Check<40>() + Check<50>() + Check<100>();
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,173 @@
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+#include "json.hpp"
+#include "steer_message.h"
+
+// Checks WriteDouble and WriteSteer against what json::dump wrote before,
+// on a fixed corpus, and times both.
+//
+// Every double of the corpus has to come out exactly as json::dump wrote
+// it, with one accepted difference: where "%.15g" was lossy, i.e. its
+// output does not read back as the same double, WriteDouble writes the 16
+// or 17 digits that do; subnormals may also come out shorter. Either way
+// the output has to read back as the same double. Replies whose numbers
+// have at most 15 significant digits, which is every number json::dump
+// wrote correctly, have to match byte for byte.
+//
+//   test_steer_message
+//
+// Exits with a nonzero status on the first mismatch.
+
+using json = nlohmann::json;
+using std::string;
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+// What main wrote before WriteSteer.
+string JsonSteer(double steering_angle, double throttle, const std::vector<double> &mpc_x,
+	const std::vector<double> &mpc_y, const std::vector<double> &next_x,
+	const std::vector<double> &next_y) {
+	json msgJson;
+	msgJson["steering_angle"] = steering_angle;
+	msgJson["throttle"] = throttle;
+	msgJson["mpc_x"] = mpc_x;
+	msgJson["mpc_y"] = mpc_y;
+	msgJson["next_x"] = next_x;
+	msgJson["next_y"] = next_y;
+	return "42[\"steer\"," + msgJson.dump() + "]";
+}
+
+bool ReadsBackAs(const string &text, double value) {
+	return std::strtod(text.c_str(), nullptr) == value;
+}
+
+// The corpus: edge cases, then seeded random values of the magnitudes a
+// reply has, of any magnitude, and of any bit pattern.
+std::vector<double> Corpus() {
+	const double max = std::numeric_limits<double>::max();
+	const double min = std::numeric_limits<double>::min();
+	const double denorm_min = std::numeric_limits<double>::denorm_min();
+	std::vector<double> values = {
+		0.0, -0.0, 1.0, -1.0, 0.1, 0.2, 0.3, 1.0 / 3.0, 2.0 / 3.0, 100.0, 12345.0,
+		1e-4, 9.99999999999999e-5, 1e-5, 1e14, 1e15, 1e16, 1e21, 1e22, 1e23,
+		123456789012345.0, 1234567890123456.0, 0.1 + 0.2, 3.141592653589793,
+		2.718281828459045, 0.436332, 5e-324, 1e-310, 1e-300, 1e300,
+		max, -max, min, -min, denorm_min, min - denorm_min,
+		std::numeric_limits<double>::infinity(), -std::numeric_limits<double>::infinity(),
+		std::numeric_limits<double>::quiet_NaN()
+	};
+
+	std::mt19937_64 random(42);
+	std::uniform_real_distribution<double> reply(-100.0, 100.0);
+	std::uniform_real_distribution<double> mantissa(1.0, 10.0);
+	std::uniform_int_distribution<int> power(-30, 30);
+	for (int i = 0; i < 100000; i++) {
+		values.push_back(reply(random));
+		values.push_back(mantissa(random) * std::pow(10.0, power(random)));
+		const std::uint64_t bits = random();
+		double value;
+		std::memcpy(&value, &bits, sizeof(value));
+		values.push_back(value);
+	}
+	return values;
+}
+
+// Returns the number of doubles that differ other than accepted.
+int CheckDoubles(const std::vector<double> &values) {
+	int failures = 0;
+	int lossy = 0;
+	int subnormal = 0;
+	char number[max_double_length];
+	for (double value : values) {
+		const string ours(number, WriteDouble(value, number));
+		const string theirs = json(value).dump();
+		if (ours == theirs) {
+			continue;
+		}
+		const bool round_trips = std::isfinite(value) && ReadsBackAs(ours, value);
+		if (round_trips && !ReadsBackAs(theirs, value)) {
+			lossy++;
+			continue;
+		}
+		if (round_trips && std::fpclassify(value) == FP_SUBNORMAL && ours.size() < theirs.size()) {
+			subnormal++;
+			continue;
+		}
+		if (failures++ < 10) {
+			std::printf("%.17g: %s, json::dump %s\n", value, ours.c_str(), theirs.c_str());
+		}
+	}
+	std::printf("%zu doubles: %d differ where %%.15g was lossy, %d shorter subnormals, %d mismatches\n",
+		values.size(), lossy, subnormal, failures);
+	return failures;
+}
+
+// Returns the number of replies that differ, and prints the time per reply
+// of both.
+int CheckReplies() {
+	// As many points as main sends.
+	const std::size_t n_mpc = 9;
+	const std::size_t n_next = 25;
+	const int n_replies = 20000;
+
+	std::mt19937_64 random(7);
+	std::uniform_real_distribution<double> coordinate(-50.0, 50.0);
+	std::uniform_real_distribution<double> actuation(-1.0, 1.0);
+	// Rounded to the 15 digits json::dump writes.
+	auto rounded = [](double value) {
+		char text[32];
+		snprintf(text, sizeof(text), "%.15g", value);
+		return std::strtod(text, nullptr);
+	};
+	std::vector<double> mpc_x(n_mpc), mpc_y(n_mpc), next_x(n_next), next_y(n_next);
+
+	int failures = 0;
+	double ours_time = 0.0;
+	double theirs_time = 0.0;
+	string ours;
+	for (int i = 0; i < n_replies; i++) {
+		for (std::size_t j = 0; j < n_mpc; j++) {
+			mpc_x[j] = rounded(coordinate(random));
+			mpc_y[j] = rounded(coordinate(random));
+		}
+		for (std::size_t j = 0; j < n_next; j++) {
+			next_x[j] = rounded(2.0 * j);
+			next_y[j] = rounded(coordinate(random));
+		}
+		const double steering_angle = rounded(actuation(random));
+		const double throttle = rounded(actuation(random));
+
+		Clock::time_point start = Clock::now();
+		WriteSteer(steering_angle, throttle, mpc_x.data(), mpc_y.data(), n_mpc, next_x.data(),
+			next_y.data(), n_next, Wire_format::TEXT, ours);
+		Clock::time_point middle = Clock::now();
+		const string theirs = JsonSteer(steering_angle, throttle, mpc_x, mpc_y, next_x, next_y);
+		Clock::time_point end = Clock::now();
+		ours_time += std::chrono::duration<double>(middle - start).count();
+		theirs_time += std::chrono::duration<double>(end - middle).count();
+
+		if (ours != theirs && failures++ < 3) {
+			std::printf("reply differs:\n  %s\n  %s\n", ours.c_str(), theirs.c_str());
+		}
+	}
+	std::printf("%d replies: %d mismatches; %.2f us per reply, json::dump %.2f us\n", n_replies,
+		failures, 1e6 * ours_time / n_replies, 1e6 * theirs_time / n_replies);
+	return failures;
+}
+
+}  // namespace
+
+int main() {
+	int failures = CheckDoubles(Corpus()) + CheckReplies();
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,123 @@
+#include <cmath>
+#include <cstdio>
+#include "helpers.h"
+#include "track.h"
+
+// Checks Track::Project and Track::LocalReference on the lake track: car
+// poses are put at known arc lengths, offset sideways from the center line
+// and turned against it. The projection has to find the arc length again,
+// and the reference has to run through the center line point beside the
+// car with the center line's heading, which for a car parallel to the
+// center line is cte = -offset and epsi = 0.
+//
+// Project runs without a hint (the segment index), with a hint inside the
+// window, with one far outside it (back to the index), and with hints on
+// the other side of the start of the lap. LocalReference has to refuse cars
+// sideways or backwards to the center line.
+//
+//   test_track lake_track_waypoints.csv
+//
+// Exits with a nonzero status if any check fails.
+
+namespace {
+
+int failures = 0;
+
+void Expect(bool ok, const char *what, double s, double offset, double turn, double got, double want) {
+	if (!ok && failures++ < 10) {
+		std::printf("s %.2f offset %.1f turn %.2f: %s %.6g, expected %.6g\n", s, offset, turn, what, got,
+			want);
+	}
+}
+
+// Difference of two arc lengths on a lap of `length`, in [-length / 2,
+// length / 2].
+double LapDifference(double a, double b, double length) {
+	return std::remainder(a - b, length);
+}
+
+}  // namespace
+
+int main(int argc, char *argv[]) {
+	if (argc < 2) {
+		std::printf("Usage: test_track lake_track_waypoints.csv\n");
+		return 1;
+	}
+	Track track;
+	if (!track.Load(argv[1])) {
+		std::printf("Failed to load %s\n", argv[1]);
+		return 1;
+	}
+	const double length = track.Length();
+	const Track::Point start = track.At(0.0), end = track.At(length);
+	Expect(std::hypot(start.x - end.x, start.y - end.y) < 1e-9, "lap closes, gap", 0.0, 0.0, 0.0,
+		std::hypot(start.x - end.x, start.y - end.y), 0.0);
+
+	// Arc lengths and cte are within a few centimeters: the center line is
+	// a polyline through samples half a meter apart.
+	const double s_tolerance = 0.05;
+	const double cte_tolerance = 0.05;
+	const double epsi_tolerance = 0.02;
+	const double lookahead = 50.0;
+	int n_poses = 0;
+	for (double s = 0.0; s < length; s += 3.7) {
+		const Track::Point point = track.At(s);
+		for (double offset : {-3.0, -1.0, 0.0, 1.0, 3.0}) {
+			// To the left of the direction of travel for a positive offset.
+			const double x = point.x - offset * std::sin(point.heading);
+			const double y = point.y + offset * std::cos(point.heading);
+			n_poses++;
+
+			const double hints[] = {-1.0, s + 3.0, s - 3.0, s + 0.5 * length,
+				// Across the start of the lap.
+				s + length - 2.0, s - length + 2.0};
+			for (double hint : hints) {
+				const double projected = track.Project(x, y, hint < 0.0 ? hint : hint - std::floor(hint / length) * length);
+				Expect(std::fabs(LapDifference(projected, s, length)) < s_tolerance && projected >= 0.0 &&
+					projected < length, "Project", s, offset, hint, projected, s);
+			}
+
+			for (double turn : {-0.3, 0.0, 0.3}) {
+				const Pose pose{x, y, point.heading + turn};
+				double track_s = -1.0;
+				Track::Coeffs coeffs;
+				if (!track.LocalReference(pose, lookahead, track_s, coeffs)) {
+					Expect(false, "LocalReference refused", s, offset, turn, 0.0, 1.0);
+					continue;
+				}
+				Expect(std::fabs(LapDifference(track_s, s, length)) < s_tolerance, "LocalReference s", s, offset,
+					turn, track_s, s);
+				// Turned by `turn`, the car sees the center line point beside
+				// it at -offset (sin(turn), cos(turn)) in its frame, running
+				// at -turn, and the cubic goes through it with that slope.
+				const double x0 = -offset * std::sin(turn);
+				const double y0 = -offset * std::cos(turn);
+				const double slope = coeffs[1] + 2.0 * coeffs[2] * x0 + 3.0 * coeffs[3] * x0 * x0;
+				Expect(std::fabs(polyeval(coeffs, x0) - y0) < cte_tolerance, "y at the center line", s, offset,
+					turn, polyeval(coeffs, x0), y0);
+				// The projection is onto chords, which is off by more where the
+				// car is further from them.
+				Expect(std::fabs(std::atan(slope) + turn) < epsi_tolerance * (1.0 + std::fabs(offset)), "heading at the center line", s,
+					offset, turn, -std::atan(slope), turn);
+				if (turn == 0.0) {
+					// Then that point is at x = 0, where main reads cte and epsi.
+					const double cte = polyeval(coeffs, 0.0);
+					const double epsi = -std::atan(coeffs[1]);
+					Expect(std::fabs(cte + offset) < cte_tolerance, "cte", s, offset, turn, cte, -offset);
+					Expect(std::fabs(epsi) < epsi_tolerance, "epsi", s, offset, turn, epsi, 0.0);
+				}
+			}
+
+			// Sideways and backwards to the center line.
+			for (double turn : {M_PI / 2, -M_PI / 2, M_PI}) {
+				double track_s = s;
+				Track::Coeffs coeffs;
+				Expect(!track.LocalReference(Pose{x, y, point.heading + turn}, lookahead, track_s, coeffs),
+					"LocalReference accepted", s, offset, turn, 1.0, 0.0);
+			}
+		}
+	}
+
+	std::printf("lap of %.1f m, %d poses, %d failures\n", length, n_poses, failures);
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,188 @@
+#include "track.h"
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+#include "Eigen-3.3/Eigen/LU"
+#include "Eigen-3.3/unsupported/Eigen/Splines"
+
+namespace {
+
+const double two_pi = 2.0 * M_PI;
+
+typedef Eigen::Spline<double, 2, 3> Spline;
+
+}  // namespace
+
+Track::Track() : length_(0.0), step_(0.0) {}
+
+bool Track::Load(const std::string &path, double spacing) {
+	std::ifstream in(path);
+	if (!in) {
+		return false;
+	}
+	std::string line;
+	// x,y
+	std::getline(in, line);
+	std::vector<double> xs, ys;
+	while (std::getline(in, line)) {
+		std::istringstream fields(line);
+		double x, y;
+		char comma;
+		if (fields >> x >> comma >> y && comma == ',') {
+			xs.push_back(x);
+			ys.push_back(y);
+		}
+	}
+	const long n = xs.size();
+	if (n < 4 || !(spacing > 0.0)) {
+		return false;
+	}
+
+	// Eigen's splines are open, so interpolate the lap with `pad` waypoints
+	// of the neighbouring laps on either side and only use the middle. With
+	// the first waypoint repeated at the end, the lap is [knots(pad),
+	// knots(pad + n)].
+	const long pad = 3;
+	Eigen::Matrix2Xd points(2, n + 2 * pad + 1);
+	for (long i = 0; i < points.cols(); i++) {
+		const long j = ((i - pad) % n + n) % n;
+		points(0, i) = xs[j];
+		points(1, i) = ys[j];
+	}
+	Spline::KnotVectorType knots;
+	Eigen::ChordLengths(points, knots);
+	const Spline spline = Eigen::SplineFitting<Spline>::Interpolate(points, 3, knots);
+	const double u_begin = knots(pad);
+	const double u_end = knots(pad + n);
+
+	// Arc length at fine steps of the spline parameter, Simpson's rule.
+	const long n_fine = 64 * n;
+	const double du = (u_end - u_begin) / n_fine;
+	auto speed = [&spline](double u) {
+		return spline.derivatives<1>(u).col(1).matrix().norm();
+	};
+	std::vector<double> fine_s(n_fine + 1);
+	fine_s[0] = 0.0;
+	for (long k = 0; k < n_fine; k++) {
+		const double u = u_begin + k * du;
+		fine_s[k + 1] = fine_s[k] + du / 6.0 * (speed(u) + 4.0 * speed(u + 0.5 * du) + speed(u + du));
+	}
+	length_ = fine_s[n_fine];
+
+	// Samples every step_ of arc length, the parameter interpolated between
+	// the fine steps around it.
+	const std::size_t n_samples = std::max(4L, std::lround(length_ / spacing));
+	step_ = length_ / n_samples;
+	x_.resize(n_samples);
+	y_.resize(n_samples);
+	heading_.resize(n_samples);
+	curvature_.resize(n_samples);
+	long k = 0;
+	for (std::size_t i = 0; i < n_samples; i++) {
+		const double s = i * step_;
+		while (k + 1 < n_fine && fine_s[k + 1] < s) {
+			k++;
+		}
+		const double u = u_begin + du * (k + (s - fine_s[k]) / (fine_s[k + 1] - fine_s[k]));
+		const auto d = spline.derivatives<2>(u);
+		const double dx = d(0, 1), dy = d(1, 1);
+		x_[i] = d(0, 0);
+		y_[i] = d(1, 0);
+		heading_[i] = std::atan2(dy, dx);
+		curvature_[i] = (dx * d(1, 2) - dy * d(0, 2)) / std::pow(dx * dx + dy * dy, 1.5);
+	}
+	index_.Build(x_.data(), y_.data(), n_samples, true);
+	return true;
+}
+
+std::size_t Track::Wrap(long i) const {
+	const long n = x_.size();
+	return ((i % n) + n) % n;
+}
+
+Track::Point Track::At(double s) const {
+	double position = s / step_;
+	const long i = long(std::floor(position));
+	const double f = position - i;
+	const std::size_t a = Wrap(i), b = Wrap(i + 1);
+	Point point;
+	point.x = x_[a] + f * (x_[b] - x_[a]);
+	point.y = y_[a] + f * (y_[b] - y_[a]);
+	point.heading = heading_[a] + f * std::remainder(heading_[b] - heading_[a], two_pi);
+	point.curvature = curvature_[a] + f * (curvature_[b] - curvature_[a]);
+	return point;
+}
+
+double Track::Project(double x, double y, double hint, double window) const {
+	const long n = x_.size();
+	if (hint < 0.0) {
+		const Segment_index::Closest_point closest = index_.Closest(x, y);
+		const double s = (closest.segment + closest.t) * step_;
+		return s - std::floor(s / length_) * length_;
+	}
+	const long first = long(std::floor((hint - window) / step_));
+	const long count = std::min(n, 2 * long(std::ceil(window / step_)) + 1);
+
+	long best = first;
+	double best_distance = INFINITY;
+	for (long i = first; i < first + count; i++) {
+		const std::size_t j = Wrap(i);
+		const double distance = (x_[j] - x) * (x_[j] - x) + (y_[j] - y) * (y_[j] - y);
+		if (distance < best_distance) {
+			best = i;
+			best_distance = distance;
+		}
+	}
+	if (count < n && (best == first || best == first + count - 1 || best_distance > window * window)) {
+		// Left the window, e.g. after a reset. A minimum inside the window can
+		// still be on the wrong part of the lap when the hint is stale, where
+		// the track bends towards the car: then it is far from the car.
+		return Project(x, y);
+	}
+
+	// Onto the segments to either neighbour.
+	double best_index = best;
+	for (long i = best - 1; i <= best; i++) {
+		const std::size_t a = Wrap(i), b = Wrap(i + 1);
+		const double ex = x_[b] - x_[a], ey = y_[b] - y_[a];
+		const double t = std::max(0.0, std::min(1.0, ((x - x_[a]) * ex + (y - y_[a]) * ey) / (ex * ex + ey * ey)));
+		const double px = x_[a] + t * ex - x, py = y_[a] + t * ey - y;
+		const double distance = px * px + py * py;
+		if (distance < best_distance) {
+			best_index = i + t;
+			best_distance = distance;
+		}
+	}
+	const double s = best_index * step_;
+	return s - std::floor(s / length_) * length_;
+}
+
+bool Track::LocalReference(const Pose &pose, double lookahead, double &s, Coeffs &coeffs) const {
+	s = Project(pose.x, pose.y, s);
+
+	const Point ahead[3] = {At(s), At(s + 0.5 * lookahead), At(s + lookahead)};
+	double map_x[3], map_y[3], car_x[3], car_y[3];
+	for (int i = 0; i < 3; i++) {
+		map_x[i] = ahead[i].x;
+		map_y[i] = ahead[i].y;
+	}
+	MapToCar(pose, map_x, map_y, 3, car_x, car_y);
+	const double heading = std::remainder(ahead[0].heading - pose.psi, two_pi);
+	// Within about 80 degrees, so the slope stays finite.
+	if (!(car_x[0] < car_x[1] && car_x[1] < car_x[2]) || std::cos(heading) < 0.17) {
+		return false;
+	}
+
+	Eigen::Matrix4d A;
+	Coeffs b;
+	for (int i = 0; i < 3; i++) {
+		const int row = i == 0 ? 0 : i + 1;
+		A.row(row) << 1.0, car_x[i], car_x[i] * car_x[i], car_x[i] * car_x[i] * car_x[i];
+		b[row] = car_y[i];
+	}
+	A.row(1) << 0.0, 1.0, 2.0 * car_x[0], 3.0 * car_x[0] * car_x[0];
+	b[1] = std::tan(heading);
+	coeffs = A.partialPivLu().solve(b);
+	return true;
+}
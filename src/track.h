@@ -0,0 +1,82 @@
+#ifndef TRACK_H
+#define TRACK_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include "Eigen-3.3/Eigen/Core"
+#include "frame_transform.h"
+#include "segment_index.h"
+
+// The center line of a closed track, loaded once from the waypoints in
+// lake_track_waypoints.csv instead of refitted from the simulator's six
+// waypoints on every message.
+//
+// Load interpolates the waypoints with a cubic B-spline (Eigen's
+// unsupported Splines module), reparameterizes it by arc length and samples
+// position, heading and curvature every `spacing` meters into tables. All
+// queries are lookups in these tables, and searches for the closest sample
+// without a nearby hint go through a Segment_index over them.
+class Track {
+ public:
+  // The center line at arc length s.
+  struct Point {
+    double x;
+    double y;
+    // Direction of travel, radians from the x axis.
+    double heading;
+    // 1 / radius, positive when turning left.
+    double curvature;
+  };
+
+  typedef Eigen::Matrix<double, 4, 1> Coeffs;
+
+  Track();
+
+  // Reads `path`, a CSV file with a header line and one "x,y" waypoint per
+  // line in the direction of travel, the last one followed by the first.
+  // Returns false if it cannot be read or has fewer than 4 waypoints.
+  bool Load(const std::string &path, double spacing = 0.5);
+
+  bool Loaded() const { return !x_.empty(); }
+  // Arc length of one lap.
+  double Length() const { return length_; }
+
+  // Interpolated between the samples around s, which wraps around the lap.
+  Point At(double s) const;
+
+  // Arc length of the center line point closest to (x, y). With a `hint`
+  // >= 0, e.g. the last result for the same car, only `window` meters on
+  // either side of it are searched, and the whole lap, through the index,
+  // only when the closest point ends up at the edge of the window or more
+  // than `window` away from (x, y).
+  double Project(double x, double y, double hint = -1.0, double window = 10.0) const;
+
+  // The local reference for the car at `pose`, in the form MPC::Solve takes:
+  // a cubic y(x) in the car frame through the closest center line point,
+  // with its heading there, and through the center line points `lookahead`
+  // / 2 and `lookahead` meters further on. Four conditions, so the cubic is
+  // exact rather than a least-squares fit.
+  //
+  // `s` is the hint for Project and is updated to the car's arc length, keep
+  // it per car; start with -1. Returns false when the center line ahead does
+  // not run forward in the car frame, e.g. the car is sideways to it.
+  bool LocalReference(const Pose &pose, double lookahead, double &s, Coeffs &coeffs) const;
+
+ private:
+  // Sample index, wrapped around the lap.
+  std::size_t Wrap(long i) const;
+
+  double length_;
+  // Distance between samples.
+  double step_;
+  // Sample i is at arc length i * step_.
+  std::vector<double> x_;
+  std::vector<double> y_;
+  std::vector<double> heading_;
+  std::vector<double> curvature_;
+  // Over the closed polyline through the samples.
+  Segment_index index_;
+};
+
+#endif  // TRACK_H